@@ -2,86 +2,401 @@
  * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ai.h"
 #include "board.h"
+#include "checkpoint.h"
 #include "common.h"
+#include "db.h"
+#include "endgame.h"
+#include "eval.h"
 #include "hash.h"
+#include "params.h"
+#include "timer.h"
+#include "trace.h"
+#include "tss.h"
 
-static unsigned long ai_counter = 0; /* Steps the AI took to solve a board. */
+/* Each thread of ybw_solve() keeps its own counter and move order tables. */
+static THREAD_LOCAL unsigned long ai_counter = 0; /* Steps the AI took to
+                                                     solve a board. */
 
-static long move_scores[MAX_TURNS][MAX_COLS]; /* Contains score for each column
-                                                 for each depth. */ 
+static THREAD_LOCAL long move_scores[MAX_TURNS][MAX_COLS]; /* Contains score
+                                                   for each column for each
+                                                   depth. */
+static THREAD_LOCAL signed char killers[MAX_TURNS][2]; /* Last two cut-off
+                                                   moves of each depth, -1 if
+                                                   none. */
+static THREAD_LOCAL signed char countermoves[2][MAX_COLS]; /* Last cut-off
+                                                   move of each player after
+                                                   each move of the opponent,
+                                                   -1 if none. */
+
+static const char *checkpoint_file     = NULL; /* Where to save checkpoints. */
+static double checkpoint_every         = 0;    /* Seconds between them. */
+static double next_checkpoint          = 0;    /* Time of the next one. */
+static board *current_board            = NULL; /* Board being solved. */
+static root_progress *current_progress = NULL; /* Its progress at the root. */
+
+static FILE *progress_out              = NULL; /* Where to report progress. */
+static double progress_every           = 0;    /* Seconds between reports. */
+static double next_progress            = 0;    /* Time of the next report. */
+static double solve_start              = 0;    /* Time the solve started. */
+
+/* The line currently searched by search_root(), for progress reports. */
+static int line_turn     = -1; /* turn of the second ply, -1 if not solving */
+static int line_root     = -1; /* root move being searched */
+static int line_second   = -1; /* second ply move being searched */
+static int second_done   = 0;  /* second ply moves finished */
+static int second_total  = 0;  /* second ply moves to search */
+static unsigned long root_start = 0; /* steps when the root move started */
+
+static int trace_until = 0; /* Trace boards before that turn. */
+
+static solution_db *db = NULL; /* Strong solution consulted by
+                                  recommend_move(), if any. */
+
+static void report_progress(double now, int done);
 
 /* Solves board from scratch, prints result. */
 board_state solve(board *board)
 {
-    board_state res;
-        
+    root_progress progress;
+
     printf("Solving %dx%d board now.\n", board->size->x, board->size->y);
     print_board(board);
     
     init_ai(board);
-    
+    init_root_progress(&progress);
+    return continue_solve(board, &progress);
+}
+
+/* Solves board, skipping all root moves already proven in progress. Expects
+ * the AI to be initialized. Prints result. */
+board_state continue_solve(board *board, root_progress *progress)
+{
+    board_state res;
+    search_board sb;
+    double start = get_time();
+
     printf("Solving...\n");
-    res = alpha_beta(board, LOSE, WIN);
+    init_search_board(&sb, board);
+    current_board    = board;
+    current_progress = progress;
+    solve_start      = start;
+    next_checkpoint  = start + checkpoint_every;
+    next_progress    = start + progress_every;
+    line_turn        = sb.turn + 1;
+    printf("First node after %.3fms.\n", (get_time() - start) * 1000);
+    res = search_root(&sb, progress);
+    if (progress_out != NULL) {
+        report_progress(get_time(), 1);
+    }
+    current_board    = NULL;
+    current_progress = NULL;
+    line_turn        = -1;
     printf("Done. Took %lu steps.\n", ai_counter);
+    trace_flush();
     print_hash_stats();
+    print_eval_stats();
+    print_endgame_stats();
+    print_result(res);
+    return res;
+}
+
+/* Searches all root moves not proven yet, best first, and records their
+ * results in progress. Returns the result of the board. */
+board_state search_root(search_board *sb, root_progress *progress)
+{
+    board_state alpha, temp;
+    board_state beta = WIN;
+    int moves[MAX_COLS];
+    int i, j;
+
+    if (sb->turn >= sb->max_turns) {
+        return DRAW;
+    }
+
+    for (i = 0; i < sb->x; i++) {
+        moves[i] = i;
+    }
+    reorder_moves(sb, moves);
+
+    alpha = max(LOSE, progress->res);
+    for (j = 0; j < sb->x && alpha < beta; j++) {
+        i = moves[j];
+        if (!search_column_free(sb, i) || progress->value[i] != UNKNOWN) {
+            continue;
+        }
+        line_root    = i;
+        line_second  = -1;
+        second_done  = second_total = 0;
+        root_start   = ai_counter;
+        if (search_wins_with(sb, i, sb->player)) {
+            temp = WIN;
+        } else {
+            search_move(sb, i);
+            temp = -alpha_beta(sb, -beta, -alpha);
+            search_undo(sb, i);
+        }
+        progress->nodes[i] = ai_counter - root_start;
+        progress->value[i] = temp;
+        progress->res      = max(progress->res, temp);
+        alpha              = max(alpha, temp);
+    }
+    return progress->res;
+}
+
+/* Marks all root moves as unproven. */
+void init_root_progress(root_progress *progress)
+{
+    int i;
+
+    progress->res = UNKNOWN;
+    for (i = 0; i < MAX_COLS; i++) {
+        progress->value[i] = UNKNOWN;
+        progress->nodes[i] = 0;
+    }
+}
+
+/* Save a checkpoint of the running solve() to file every that many seconds.
+ * Pass NULL to turn it off. */
+void set_checkpoint(const char *file, double every)
+{
+    checkpoint_file  = file;
+    checkpoint_every = every;
+}
+
+/* Report progress of the running solve() as JSON lines to out every that many
+ * seconds. Pass NULL to turn it off. */
+void set_progress(FILE *out, double every)
+{
+    progress_out   = out;
+    progress_every = every;
+}
+
+/* Estimates the seconds left from the subtree sizes seen so far. Finished root
+ * moves give the expected size of the ones still open, finished second ply
+ * moves the expected size of the current one. This is rough, as cut-offs make
+ * later moves much cheaper. */
+static double estimate_eta(double nps)
+{
+    unsigned long finished = 0, current;
+    double expected, avg;
+    int i, n = 0, open = 0;
 
-    printf("Result: ");
+    for (i = 0; i < current_board->size->x; i++) {
+        if (current_progress->value[i] != UNKNOWN) {
+            finished += current_progress->nodes[i];
+            n++;
+        } else if (column_free(current_board, i) && i != line_root) {
+            open++;
+        }
+    }
+    if (current_progress->res == WIN) {
+        open = 0; /* cut-off at the root */
+    }
+
+    current  = ai_counter - root_start;
+    expected = current;
+    if (second_total > 0) {
+        expected = current * (double) second_total / (second_done + 0.5);
+    }
+    avg = n > 0 ? (double) finished / n : expected;
+    return max(0, expected - current + open * avg) / (nps > 0 ? nps : 1);
+}
+
+/* Writes one JSON line describing the running solve. */
+static void report_progress(double now, int done)
+{
+    static const char *names[] = { "lose", "maybe_lose", "draw",
+                                   "maybe_win", "win" };
+    double elapsed = now - solve_start;
+    double nps     = ai_counter / (elapsed > 0 ? elapsed : 1e-9);
+    board_state v;
+    int i, first = 1;
+
+    fprintf(progress_out,
+            "{\"elapsed\":%.3f,\"nodes\":%lu,\"nodes_per_sec\":%.0f,"
+            "\"hash_fill\":%.4f,\"done\":%s,",
+            elapsed, ai_counter, nps, (double) hash_entries() / hash_slots(),
+            done ? "true" : "false");
+    if (!done) {
+        fprintf(progress_out,
+                "\"root_move\":%d,\"second_move\":%d,"
+                "\"second_done\":%d,\"second_total\":%d,\"eta\":%.1f,",
+                line_root, line_second, second_done, second_total,
+                estimate_eta(nps));
+    }
+    fprintf(progress_out, "\"proven\":[");
+    for (i = 0; i < current_board->size->x; i++) {
+        v = current_progress->value[i];
+        if (v != UNKNOWN) {
+            fprintf(progress_out, "%s{\"move\":%d,\"value\":\"%s\","
+                    "\"nodes\":%lu}", first ? "" : ",", i, names[v - LOSE],
+                    current_progress->nodes[i]);
+            first = 0;
+        }
+    }
+    fprintf(progress_out, "]}\n");
+    fflush(progress_out);
+}
+
+/* Called every POLL_INTERVAL steps to handle timed events. */
+static void poll_ai()
+{
+    double now;
+
+    if (current_board == NULL ||
+        (checkpoint_file == NULL && progress_out == NULL)) {
+        return;
+    }
+    now = get_time();
+    if (checkpoint_file != NULL && now >= next_checkpoint) {
+        save_checkpoint(checkpoint_file, current_board, current_progress);
+        next_checkpoint = now + checkpoint_every;
+    }
+    if (progress_out != NULL && now >= next_progress) {
+        report_progress(now, 0);
+        next_progress = now + progress_every;
+    }
+}
+
+/* Returns the name of an exact result. */
+const char *state_name(board_state res)
+{
     switch (res) {
         case LOSE:
-            printf("lose");
-            break;
+            return "lose";
         case DRAW:
-            printf("draw");
-            break;
+            return "draw";
         case WIN:
-            printf("win");
-            break;
+            return "win";
         default:
-            printf("shit blew up :<");
-            break;
+            return "shit blew up :<";
+    }
+}
+
+/* Prints result of a solved board. */
+void print_result(board_state res)
+{
+    printf("Result: %s.\n", state_name(res));
+}
+
+static board_state search_node(search_board *sb, board_state alpha,
+                               board_state beta, trace_record *rec);
+
+/* Remembers col as killer of its depth and as the answer to last. */
+static inline void note_cutoff(search_board *sb, int col, int last)
+{
+    if (killers[sb->turn][0] != col) {
+        killers[sb->turn][1] = killers[sb->turn][0];
+        killers[sb->turn][0] = col;
+    }
+    if (last >= 0) {
+        countermoves[sb->player][last] = col;
     }
-    printf(".\n");
-    return res;
+}
+
+/* Searches sb like search_node() and writes a trace record for it. */
+static board_state trace_node(search_board *sb, board_state alpha,
+                              board_state beta)
+{
+    trace_record rec;
+    unsigned long start = ai_counter;
+
+    rec.ply    = sb->turn;
+    rec.move   = -1;
+    rec.alpha  = alpha;
+    rec.beta   = beta;
+    rec.hash   = UNKNOWN;
+    rec.cutoff = -1;
+    rec.tried  = 0;
+    rec.res    = search_node(sb, alpha, beta, &rec);
+    rec.nodes  = ai_counter - start;
+    trace_write(&rec);
+    return rec.res;
 }
 
 /* Alpha-beta search, returns result. */
-board_state alpha_beta(board *board, board_state alpha, board_state beta)
+board_state alpha_beta(search_board *sb, board_state alpha, board_state beta)
+{
+#if USE_ITERATIVE == 1
+    search_stack st;
+
+    init_search_stack(&st, sb, alpha, beta);
+    return search_run(&st, ULONG_MAX);
+#else
+    return recursive_alpha_beta(sb, alpha, beta);
+#endif
+}
+
+/* Alpha-beta search on the C stack, same results as alpha_beta(). */
+board_state recursive_alpha_beta(search_board *sb, board_state alpha,
+                                 board_state beta)
+{
+    trace_record rec; /* ignored */
+
+    if (sb->turn < trace_until) {
+        return trace_node(sb, alpha, beta);
+    }
+    return search_node(sb, alpha, beta, &rec);
+}
+
+/* Does the actual work of recursive_alpha_beta(). Notes the hash result, the
+ * best move and cut-offs in rec. */
+static board_state search_node(search_board *sb, board_state alpha,
+                               board_state beta, trace_record *rec)
 {
     board_state temp   = UNKNOWN;
     board_state res    = UNKNOWN;
     board_state hash   = UNKNOWN;
+#if USE_EVAL == 1
+    board_state eval   = UNKNOWN;
+#endif
     int threat         = -1;
     int possible_moves = 0;
+    int hash_move      = -1; /* best move stored in the hash */
+    int best_move      = -1;
+    int last           = sb->last; /* gone once a move was searched */
+    uint64_t own_wins, opp_wins; /* fields completing a line for each side */
     int i, j;
-    int reordered_moves[MAX_COLS]; /* Contains columns to check. */
+    int ordered_moves[MAX_COLS]; /* Contains columns to check. */
 #if AI_DEBUG == 1
     long n;
 #endif
 
     ai_counter += 1;
+    if ((ai_counter & (POLL_INTERVAL-1)) == 0) {
+        poll_ai();
+    }
                 
 #if AI_DEBUG == 1
     n = ai_counter;
-    if (board->turn <= DEBUG_DEPTH) {
+    if (sb->turn <= DEBUG_DEPTH) {
         printf("Starting alpha-beta #%d...\n", n);
         printf("Alpha: %d, beta: %d.\n", alpha, beta);
-        print_board(board);
+        print_search_board(sb);
     }
 #endif
 
     /* Check if the game is already over. */
-    if (board->turn >= board->max_turns) {
+    if (sb->turn >= sb->max_turns) {
         return DRAW;
     }
 
+    /* Few empty fields left, so a plain search beats all the bookkeeping. */
+    if (sb->max_turns - sb->turn <= params.endgame_empty) {
+        return endgame(sb, alpha, beta);
+    }
+
     /* Check if a solution is available in the hash. */
-    hash = get_hash(board);
+    hash = get_hash(sb, &hash_move);
+    rec->hash = hash;
 #if AI_DEBUG == 1
-    if (board->turn <= DEBUG_DEPTH) {
+    if (sb->turn <= DEBUG_DEPTH) {
         printf("Hash: %d\n", hash);
     }
 #endif
@@ -110,51 +425,74 @@ board_state alpha_beta(board *board, board_state alpha, board_state beta)
             /* do nothing */
             break;
     }
-    
-    /* Don't reorder moves near the end. This just introduces noise. */
-    if (board->turn <= REORDER_DEPTH) {
-        /* Prepare re-ordered moves. */
-        for (i = 0; i < board->size->x; i++) {
-            reordered_moves[i] = i;
-        }
-        reorder_moves(board, reordered_moves);
+
+#if USE_EVAL == 1
+    /* The odd/even rules and the open lines may decide the board or at least
+     * bound it. */
+    eval = static_eval(sb);
+    switch (eval) {
+        case WIN:
+        case LOSE:
+        case DRAW:
+            return set_hash(sb, eval, -1);
+        case MAYBE_LOSE:
+        case MAYBE_WIN:
+            if (eval == -hash) { /* upper and lower bound meet */
+                return set_hash(sb, DRAW, hash_move);
+            }
+            if (eval == MAYBE_LOSE) {
+                beta = min(beta, DRAW);
+            } else {
+                alpha = max(alpha, DRAW);
+            }
+            if (alpha >= beta) {
+                return set_hash(sb, eval, -1);
+            }
+            hash = eval;
+            break;
+        default:
+            break;
     }
+#endif
+    
+    order_moves(sb, hash_move, ordered_moves);
 #if AI_DEBUG == 1
-    if (board->turn <= (min(DEBUG_DEPTH, REORDER_DEPTH))) {
-        printf("Reordered: ");
-        for (i = 0; i < board->size->x; i++) {
-            printf("%d ", reordered_moves[i]);
+    if (sb->turn <= DEBUG_DEPTH) {
+        printf("Ordered: ");
+        for (i = 0; i < sb->x; i++) {
+            printf("%d ", ordered_moves[i]);
         }
         printf("\n");
     }
 #endif
     
 #if AI_DEBUG == 1
-    if (board->turn <= DEBUG_DEPTH) {
+    if (sb->turn <= DEBUG_DEPTH) {
         printf("Checking for threats and winning moves...\n");
     }
 #endif
     /* Detect all threats and winning moves. If there is more than 1 threat, 
      * the board is lost. */
-    for (i = 0; i < board->size->x; i++) {
-        if (column_free(board, i)) {
+    own_wins = search_wins(sb, sb->player);
+    opp_wins = search_wins(sb, sb->player^1);
+    for (i = 0; i < sb->x; i++) {
+        if (search_column_free(sb, i)) {
             /* Note number of available moves for later. */
             possible_moves += 1;
 
 #if AI_DEBUG == 1
-            if (board->turn <= DEBUG_DEPTH) {
+            if (sb->turn <= DEBUG_DEPTH) {
                 printf("Threat on %d?\n", i);
             }
 #endif
             /* Threat? Once there are already 2 threats, don't check for 
              * more. */
             if (threat != -2) {
-                fast_move(board, i, board->player^1);
-                if (has_won(board, board->player^1)) {
+                if (opp_wins & search_move_bit(sb, i)) {
 #if AI_DEBUG == 1
-                    if (board->turn <= DEBUG_DEPTH) {
+                    if (sb->turn <= DEBUG_DEPTH) {
                         printf("Threat found: %d\n", i);
-                        print_board(board);
+                        print_search_board(sb);
                     }
 #endif
                     if (threat == -1) {
@@ -165,26 +503,22 @@ board_state alpha_beta(board *board, board_state alpha, board_state beta)
                         threat = -2;
                     }
                 }
-                fast_undo(board, i, board->player^1);
             }
 
 #if AI_DEBUG == 1
-            if (board->turn <= DEBUG_DEPTH) {
+            if (sb->turn <= DEBUG_DEPTH) {
                 printf("Winning move on %d?\n", i);
             }
 #endif
             /* winning move? */
-            fast_move(board, i, board->player);
-            if (has_won(board, board->player)) {
+            if (own_wins & search_move_bit(sb, i)) {
 #if AI_DEBUG == 1
-                if (board->turn <= DEBUG_DEPTH) {
+                if (sb->turn <= DEBUG_DEPTH) {
                     printf("Winning move found: %d\n", i);
                 }
 #endif
-                fast_undo(board, i, board->player);
-                return set_hash(board, WIN);
+                return set_hash(sb, WIN, i);
             }
-            fast_undo(board, i, board->player);
         }
     }
 
@@ -194,66 +528,86 @@ board_state alpha_beta(board *board, board_state alpha, board_state beta)
     } else if (threat > -1) {
         /* There is a threat, so act against it. */
 #if AI_DEBUG == 1
-        if (board->turn <= DEBUG_DEPTH) {
+        if (sb->turn <= DEBUG_DEPTH) {
             printf("Acting on threat...\n");
         }
 #endif
-        move(board, threat);
-        temp = -alpha_beta(board, -beta, -alpha);
+        if (sb->turn == line_turn) {
+            line_second  = threat;
+            second_total = 1;
+        }
+        search_move(sb, threat);
+        temp = -recursive_alpha_beta(sb, -beta, -alpha);
+        best_move  = threat;
+        rec->tried = 1;
         /* Improve score. */
         res = max(res, temp);
         alpha = max(res, alpha);
 #if AI_DEBUG == 1
-        if (board->turn <= DEBUG_DEPTH) {
+        if (sb->turn <= DEBUG_DEPTH) {
             printf("Got back in #%d: %d (res: %d, alpha: %d)\n", 
                    n, temp, res, alpha); 
         }
 #endif
-        undo(board, 1);
+        search_undo(sb, threat);
+        if (sb->turn == line_turn) {
+            second_done = 1;
+        }
     } else { 
         /* No threat, so try all possible moves. */
 #if AI_DEBUG == 1
-        if (board->turn <= DEBUG_DEPTH) {
+        if (sb->turn <= DEBUG_DEPTH) {
             printf("Testing all %d moves...\n", possible_moves);
         }
 #endif
-        for (j = 0; j < board->size->x; j++) {
-            if (board->turn <= REORDER_DEPTH) {
-                i = reordered_moves[j];
-            } else {
-                i = j;
-            }
-            if (column_free(board, i)) {
-                move(board, i);
-                temp = -alpha_beta(board, -beta, -alpha);
+        if (sb->turn == line_turn) {
+            second_total = possible_moves;
+        }
+        for (j = 0; j < sb->x; j++) {
+            i = ordered_moves[j];
+            if (search_column_free(sb, i)) {
+                if (sb->turn == line_turn) {
+                    line_second = i;
+                }
+                search_move(sb, i);
+                temp = -recursive_alpha_beta(sb, -beta, -alpha);
+                rec->tried += 1;
+                if (temp > res) {
+                    best_move = i;
+                }
                 /* Improve score. */
                 res = max(res, temp);
                 alpha = max(res, alpha);
 #if AI_DEBUG == 1
-                if (board->turn <= DEBUG_DEPTH) {
+                if (sb->turn <= DEBUG_DEPTH) {
                     printf("Got back in #%d: %d (res: %d, alpha: %d)\n", 
                             n, temp, res, alpha); 
                 }
 #endif
-                undo(board, 1);
+                search_undo(sb, i);
                 possible_moves -= 1;
+                if (sb->turn == line_turn) {
+                    second_done += 1;
+                }
 
                 if (alpha >= beta) { /* cut-off */
+                    rec->cutoff = rec->tried - 1;
+                    note_cutoff(sb, i, last);
                     /* A low beta may hide a successful WIN, which doesn't
                      * matter this time, but if we saved it like this, the hash
                      * would be wrong, so correct for this. */
                     if (possible_moves > 0) {
                         /* Reward columns with cut-offs, but only until a 
                          * certain depth. */
-                        if (board->turn <= REORDER_DEPTH) {
-                            score_move(board, i);
+                        if (sb->turn <= params.reorder_depth) {
+                            score_move(sb, i);
                         }
                         if (res == DRAW) {
                             res = MAYBE_WIN;
                         }
                     }
 #if AI_DEBUG == 1
-                    if (board->turn <= DEBUG_DEPTH) {
+                    if (sb->turn <= DEBUG_DEPTH) {
                         printf("Cut-off: %d\n", res);
                     }
 #endif
@@ -271,11 +625,395 @@ board_state alpha_beta(board *board, board_state alpha, board_state beta)
     }
 
 #if AI_DEBUG == 1
-    if (board->turn <= DEBUG_DEPTH) {
+    if (sb->turn <= DEBUG_DEPTH) {
         printf("Res from #%d: %d\n", n, res);
     }
 #endif
-    return set_hash(board, res);
+    rec->move = best_move;
+    return set_hash(sb, res, best_move);
+}
+
+/* Stages of a search_frame. */
+enum {
+    FRAME_ENTER,  /* board not looked at yet, only set when yielding */
+    FRAME_THREAT, /* searching the block of the only threat */
+    FRAME_MOVES   /* searching all moves, one after another */
+};
+
+/* Prepares a search of sb with the given window. Nothing is searched until
+ * search_run() or search_step() is called. */
+void init_search_stack(search_stack *st, search_board *sb,
+                       board_state alpha, board_state beta)
+{
+    search_frame *f = &st->frames[sb->turn];
+
+    st->sb    = sb;
+    st->root  = sb->turn;
+    st->res   = UNKNOWN;
+    st->steps = 0;
+    f->alpha  = alpha;
+    f->beta   = beta;
+    f->stage  = FRAME_ENTER;
+}
+
+/* Returns the next move of f to search, -1 if there is none left. */
+static inline int next_move(search_board *sb, search_frame *f)
+{
+    int i;
+
+    for (; f->j < sb->x; f->j++) {
+        i = f->moves[f->j];
+        if (search_column_free(sb, i)) {
+            f->j += 1;
+            if (sb->turn == line_turn) {
+                line_second = i;
+            }
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Stores the result of f in the hash, like the end of search_node(). */
+static inline void finish_frame(search_board *sb, search_frame *f)
+{
+    if (f->res == -f->hash) {
+        f->res = DRAW;
+    }
+    f->rec.move = f->best_move;
+    f->res      = set_hash(sb, f->res, f->best_move);
+}
+
+/* Looks at the board of f like search_node() does before searching any
+ * move. Returns the first move to search or -1 if f->res is already the
+ * result. */
+static inline int enter_frame(search_board *sb, search_frame *f)
+{
+    uint64_t own_wins, opp_wins;
+    board_state hash;
+#if USE_EVAL == 1
+    board_state eval;
+#endif
+    int threat = -1;
+    int i;
+
+    ai_counter += 1;
+    if ((ai_counter & (POLL_INTERVAL-1)) == 0) {
+        poll_ai();
+    }
+
+    if (sb->turn >= sb->max_turns) {
+        f->res = DRAW;
+        return -1;
+    }
+    if (sb->max_turns - sb->turn <= params.endgame_empty) {
+        f->res = endgame(sb, f->alpha, f->beta);
+        return -1;
+    }
+
+    f->res            = UNKNOWN;
+    f->hash           = UNKNOWN;
+    f->hash_move      = -1;
+    f->best_move      = -1;
+    f->possible_moves = 0;
+    f->last           = sb->last;
+
+    hash = f->rec.hash = get_hash(sb, &f->hash_move);
+    switch (hash) {
+        case WIN:
+        case LOSE:
+        case DRAW:
+            f->res = hash;
+            return -1;
+        case MAYBE_LOSE:
+            f->beta = DRAW;
+            if (f->alpha >= f->beta) {
+                f->res = hash;
+                return -1;
+            }
+            break;
+        case MAYBE_WIN:
+            f->alpha = DRAW;
+            if (f->alpha >= f->beta) {
+                f->res = hash;
+                return -1;
+            }
+            break;
+        default:
+            break;
+    }
+
+#if USE_EVAL == 1
+    eval = static_eval(sb);
+    switch (eval) {
+        case WIN:
+        case LOSE:
+        case DRAW:
+            f->res = set_hash(sb, eval, -1);
+            return -1;
+        case MAYBE_LOSE:
+        case MAYBE_WIN:
+            if (eval == -hash) {
+                f->res = set_hash(sb, DRAW, f->hash_move);
+                return -1;
+            }
+            if (eval == MAYBE_LOSE) {
+                f->beta = min(f->beta, DRAW);
+            } else {
+                f->alpha = max(f->alpha, DRAW);
+            }
+            if (f->alpha >= f->beta) {
+                f->res = set_hash(sb, eval, -1);
+                return -1;
+            }
+            hash = eval;
+            break;
+        default:
+            break;
+    }
+#endif
+    f->hash = hash;
+
+    order_moves(sb, f->hash_move, f->moves);
+
+    own_wins = search_wins(sb, sb->player);
+    opp_wins = search_wins(sb, sb->player^1);
+    for (i = 0; i < sb->x; i++) {
+        if (search_column_free(sb, i)) {
+            f->possible_moves += 1;
+            if (threat != -2 && (opp_wins & search_move_bit(sb, i))) {
+                threat = threat == -1 ? i : -2;
+            }
+            if (own_wins & search_move_bit(sb, i)) {
+                f->res = set_hash(sb, WIN, i);
+                return -1;
+            }
+        }
+    }
+
+    if (threat == -2) {
+        f->res = LOSE;
+        finish_frame(sb, f);
+        return -1;
+    }
+    if (threat > -1) {
+        if (sb->turn == line_turn) {
+            line_second  = threat;
+            second_total = 1;
+        }
+        f->stage = FRAME_THREAT;
+        return threat;
+    }
+    if (sb->turn == line_turn) {
+        second_total = f->possible_moves;
+    }
+    f->stage = FRAME_MOVES;
+    f->j     = 0;
+    return next_move(sb, f);
+}
+
+/* Takes the value of the move f->col of the moves stage, which was just
+ * undone. Returns 1 on a cut-off, 0 otherwise. */
+static inline int take_child(search_board *sb, search_frame *f,
+                             board_state temp)
+{
+    f->rec.tried += 1;
+    if (temp > f->res) {
+        f->best_move = f->col;
+    }
+    f->res   = max(f->res, temp);
+    f->alpha = max(f->res, f->alpha);
+    f->possible_moves -= 1;
+    if (sb->turn == line_turn) {
+        second_done += 1;
+    }
+
+    if (f->alpha >= f->beta) { /* cut-off, see search_node() */
+        f->rec.cutoff = f->rec.tried - 1;
+        note_cutoff(sb, f->col, f->last);
+        if (f->possible_moves > 0) {
+            if (sb->turn <= params.reorder_depth) {
+                score_move(sb, f->col);
+            }
+            if (f->res == DRAW) {
+                f->res = MAYBE_WIN;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/* Takes the value of the move f->col, which was just undone. Returns the next
+ * move to search or -1 if f->res is the result. */
+static inline int leave_child(search_board *sb, search_frame *f,
+                              board_state temp)
+{
+    int col;
+
+    if (f->stage == FRAME_THREAT) {
+        f->best_move = f->col;
+        f->rec.tried = 1;
+        f->res       = max(f->res, temp);
+        if (sb->turn == line_turn) {
+            second_done = 1;
+        }
+        finish_frame(sb, f);
+        return -1;
+    }
+
+    if (take_child(sb, f, temp)) {
+        finish_frame(sb, f);
+        return -1;
+    }
+    if ((col = next_move(sb, f)) < 0) {
+        finish_frame(sb, f);
+    }
+    return col;
+}
+
+/* Continues the search of st for at most steps more boards. Returns the
+ * result or UNKNOWN if the search yielded before it was done. It can then be
+ * continued by calling search_run() again. */
+board_state search_run(search_stack *st, unsigned long steps)
+{
+    search_board *sb = st->sb;
+    search_frame *f;
+    board_state temp = UNKNOWN;
+    int col, enter;
+
+    if (st->res != UNKNOWN) {
+        return st->res;
+    }
+    f     = &st->frames[sb->turn];
+    enter = f->stage == FRAME_ENTER;
+    for (;;) {
+        if (enter) {
+            if (steps == 0) {
+                f->stage = FRAME_ENTER; /* yield */
+                return UNKNOWN;
+            }
+            steps -= 1;
+            st->steps += 1;
+            if (sb->turn < trace_until) {
+                f->rec.ply    = sb->turn;
+                f->rec.move   = -1;
+                f->rec.alpha  = f->alpha;
+                f->rec.beta   = f->beta;
+                f->rec.hash   = UNKNOWN;
+                f->rec.cutoff = -1;
+                f->rec.tried  = 0;
+                f->rec.nodes  = ai_counter;
+            }
+            col = enter_frame(sb, f);
+        } else {
+            col = leave_child(sb, f, temp);
+        }
+
+        if (col >= 0) {
+            f->col = col;
+            search_move(sb, col);
+            f += 1;
+            f->alpha = -(f-1)->beta;
+            f->beta  = -(f-1)->alpha;
+            enter    = 1;
+            continue;
+        }
+
+        if (sb->turn < trace_until) {
+            f->rec.res   = f->res;
+            f->rec.nodes = ai_counter - f->rec.nodes;
+            trace_write(&f->rec);
+        }
+        if (sb->turn == st->root) {
+            st->res = f->res;
+            return st->res;
+        }
+        temp  = -f->res;
+        enter = 0;
+        f -= 1;
+        search_undo(sb, f->col);
+    }
+}
+
+/* Searches one more board of st. Returns the result or UNKNOWN if the search
+ * isn't done yet. */
+board_state search_step(search_stack *st)
+{
+    return search_run(st, 1);
+}
+
+/* The single steps of search_run(), for searches that drive the frames
+ * themselves. search_enter() looks at the board of f and returns its first
+ * move or -1 if f->res is already the result. search_leave() takes the value
+ * of the move f->col and returns the next move or -1 once f->res is the
+ * result. Instead, search_take() only takes the value of a move of the moves
+ * stage and returns 1 on a cut-off; search_next() then hands out the next
+ * move and search_finish() stores the result when done. */
+int search_enter(search_board *sb, search_frame *f)
+{
+    return enter_frame(sb, f);
+}
+
+int search_leave(search_board *sb, search_frame *f, board_state temp)
+{
+    return leave_child(sb, f, temp);
+}
+
+int search_take(search_board *sb, search_frame *f, board_state temp)
+{
+    return take_child(sb, f, temp);
+}
+
+int search_next(search_board *sb, search_frame *f)
+{
+    return next_move(sb, f);
+}
+
+void search_finish(search_board *sb, search_frame *f)
+{
+    finish_frame(sb, f);
+}
+
+/* Consult db in recommend_move() from now on. Pass NULL to stop. */
+void set_db(struct solution_db *d)
+{
+    db = d;
+}
+
+/* Recommends the next move by looking up all children in db. Returns the
+ * column, -1 if there is no move or -2 if db doesn't know the board. */
+static int recommend_from_db(board *board)
+{
+    board_state res, best = UNKNOWN;
+    int i, best_move = -1;
+
+    if (db_lookup(db, board) == UNKNOWN) {
+        return -2;
+    }
+    for (i = 0; i < board->size->x && best < WIN; i++) {
+        if (!column_free(board, i)) {
+            continue;
+        }
+        move(board, i);
+        if (has_won(board, board->player^1)) {
+            res = WIN;
+        } else if (board->turn >= board->max_turns) {
+            res = DRAW; /* Finished games aren't in db. */
+        } else {
+            res = db_lookup(db, board);
+            res = res == UNKNOWN ? UNKNOWN : -res;
+        }
+        undo(board, 1);
+        if (res == UNKNOWN) {
+            return -2; /* Broken db, let the search decide. */
+        }
+        if (res > best) {
+            best      = res;
+            best_move = i;
+        }
+    }
+    return best_move;
 }
 
 /* Recommend the next move. 
@@ -287,19 +1025,34 @@ int recommend_move(board *board)
     board_state alpha = LOSE;
     board_state beta  = WIN;
     board_state res   = UNKNOWN; 
+    search_board sb;
+    double start      = get_time();
     
     printf("Recommending move on %dx%d board now.\n", 
            board->size->x, board->size->y);
     print_board(board);
+
+    if (db != NULL && (best_move = recommend_from_db(board)) > -2) {
+        printf("Looked up in database.\n");
+        printf("Result: %d\n", best_move);
+        return best_move;
+    }
+    best_move = -1;
     
     init_ai(board);
     
     printf("Solving...\n");
-    for (i = 0; i < board->size->x; i++) {
-        if (column_free(board, i)) {
-            move(board, i);
-            if (has_won(board, board->player^1)) {
-                undo(board, 1);
+    init_search_board(&sb, board);
+    printf("First node after %.3fms.\n", (get_time() - start) * 1000);
+#if USE_TSS == 1
+    if (threat_search(&sb, TSS_DEPTH, &best_move)) {
+        printf("Won by threats.\n");
+        goto best_move_end;
+    }
+#endif
+    for (i = 0; i < sb.x; i++) {
+        if (search_column_free(&sb, i)) {
+            if (search_wins_with(&sb, i, sb.player)) {
                 best_move = i;
 #if AI_DEBUG == 1
                 printf("Best move through winning: %d.\n", best_move);
@@ -307,11 +1060,12 @@ int recommend_move(board *board)
                 goto best_move_end;
             }
 
-            res = -alpha_beta(board, -beta, -alpha);
+            search_move(&sb, i);
+            res = -alpha_beta(&sb, -beta, -alpha);
 #if AI_DEBUG == 1
             printf("Move %d would lead to: %d.\n", i, res);
 #endif
-            undo(board, 1);
+            search_undo(&sb, i);
 
             if (res >= beta) {
                 best_move = i;
@@ -332,56 +1086,244 @@ int recommend_move(board *board)
 #endif
     best_move_end:
     printf("Done. Took %lu steps.\n", ai_counter);
+    trace_flush();
     print_hash_stats();
+    print_tss_stats();
     printf("Result: %d\n", best_move);
     return best_move;
 }
 
+/* Narrows the value of the move to col down to an exact one through null
+ * windows. There are only three values, so each test asks whether the move is
+ * better or worse than a draw. The first test is against best, the best value
+ * known so far, as most moves won't beat it. */
+static board_state classify_move(search_board *sb, int col, board_state best)
+{
+    board_state lo = LOSE, hi = WIN;
+    board_state alpha, temp;
+
+    if (search_wins_with(sb, col, sb->player)) {
+        return WIN;
+    }
+
+    search_move(sb, col);
+    while (lo < hi) {
+        if (lo == DRAW || (hi == WIN && best >= DRAW)) {
+            alpha = DRAW;  /* win or not? */
+        } else {
+            alpha = LOSE;  /* lose or not? */
+        }
+        temp = -alpha_beta(sb, -(alpha + 2), -alpha);
+        switch (temp) {
+            case WIN:
+            case DRAW:
+            case LOSE:
+                lo = hi = temp;
+                break;
+            case MAYBE_WIN:
+                if (lo == DRAW) { /* no progress, use a full window */
+                    lo = hi = -alpha_beta(sb, LOSE, WIN);
+                } else {
+                    lo = DRAW;
+                }
+                break;
+            case MAYBE_LOSE:
+                if (hi == DRAW) {
+                    lo = hi = -alpha_beta(sb, LOSE, WIN);
+                } else {
+                    hi = DRAW;
+                }
+                break;
+            default:
+                abort();
+        }
+    }
+    search_undo(sb, col);
+    return lo;
+}
+
+/* Proves the value of every move, sharing the hash between them. Stores them
+ * in values, UNKNOWN for full columns. Returns the value of the board. */
+board_state analyze(board *board, board_state values[])
+{
+    board_state best = UNKNOWN;
+    search_board sb;
+    int moves[MAX_COLS];
+    int i, j;
+
+    printf("Analyzing %dx%d board now.\n", board->size->x, board->size->y);
+    print_board(board);
+
+    init_ai(board);
+    init_search_board(&sb, board);
+
+    for (i = 0; i < sb.x; i++) {
+        moves[i]  = i;
+        values[i] = UNKNOWN;
+    }
+    reorder_moves(&sb, moves);
+
+    for (j = 0; j < sb.x; j++) {
+        i = moves[j];
+        if (!search_column_free(&sb, i)) {
+            continue;
+        }
+        if (best != UNKNOWN) {
+            values[i] = classify_move(&sb, i, best);
+        } else if (search_wins_with(&sb, i, sb.player)) {
+            values[i] = WIN;
+        } else {
+            /* Nothing to compare with yet, so search the first move fully. */
+            search_move(&sb, i);
+            values[i] = -alpha_beta(&sb, LOSE, WIN);
+            search_undo(&sb, i);
+        }
+        best = max(best, values[i]);
+    }
+    if (best == UNKNOWN) {
+        best = DRAW; /* board is full */
+    }
+
+    printf("Done. Took %lu steps.\n", ai_counter);
+    trace_flush();
+    print_hash_stats();
+    for (i = 0; i < sb.x; i++) {
+        printf("Column %d: %s.\n", i,
+               values[i] == UNKNOWN ? "full" : state_name(values[i]));
+    }
+    print_result(best);
+    return best;
+}
+
 /* Initialize move reordering for given board size. */
 void init_reorder(board_size *size)
+{
+    printf("Initializing move order history...\n");
+    reset_reorder(size);
+}
+
+/* Same as init_reorder(), but quiet. Only touches the tables of the calling
+ * thread. */
+void reset_reorder(board_size *size)
 {
     int i, j, s;
 
-    printf("Initializing move order history...\n");
     for (i = 0; i < size->x; i++) {
         for (j = 0; j < MAX_TURNS; j++) {
             s = min(i, size->x - i - 1);
             move_scores[j][i] = s;
         }
     }
+    memset(killers, -1, sizeof(killers));
+    memset(countermoves, -1, sizeof(countermoves));
 }
 
-/* This is an (ugly) alternative to qsort_r() or nested functions. Sure,
- * gcc+glibc support both, but that would break my imposed standard compliance.
- * As re-entrance and thread-safety are irrelevant here anyway, the code should
- * be fine. */
-static int _depth = 0; /* Used to pass an argument into move_cmp(). */
+/* A move along with its score, so sorting doesn't need to know the depth.
+ * This keeps reorder_moves() safe to call from several threads. */
+typedef struct {
+    long score;
+    int col;
+} scored_move;
 
 /* Comparison function for sorting moves. */
 static int move_cmp(const void *a, const void *b) 
 { 
-    const int *ia = (const int *)a; // casting pointer types 
-    const int *ib = (const int *)b;
-    return move_scores[_depth][*ib] - move_scores[_depth][*ia];
+    const scored_move *ma = (const scored_move *)a;
+    const scored_move *mb = (const scored_move *)b;
+    return (mb->score > ma->score) - (mb->score < ma->score);
 } 
 
 /* Sorts moves according to scores. */
-void reorder_moves(board *board, int moves[])
+void reorder_moves(search_board *sb, int moves[])
+{
+    scored_move scored[MAX_COLS];
+    int i;
+
+    for (i = 0; i < sb->x; i++) {
+        scored[i].col   = moves[i];
+        scored[i].score = move_scores[sb->turn][moves[i]];
+    }
+    qsort(scored, sb->x, sizeof(scored_move), move_cmp);
+    for (i = 0; i < sb->x; i++) {
+        moves[i] = scored[i].col;
+    }
+}
+
+/* Puts all columns into moves in the order to search them: the hash move,
+ * the killers of the depth and the answer to the last move, then the rest by
+ * score (or left to right beyond params.reorder_depth, where sorting is just
+ * noise). Each column appears once, full ones are left for the caller to
+ * skip. */
+void order_moves(search_board *sb, int hash_move, int moves[])
 {
-    _depth = board->turn;
-    qsort(moves, board->size->x, sizeof(int), move_cmp);
+    int first[4];
+    int rest[MAX_COLS];
+    unsigned int seen = 0;
+    int i, n = 0, k = 0;
+
+    first[k++] = hash_move;
+    if (params.killer_depth >= 0 && sb->turn >= params.killer_depth) {
+        first[k++] = killers[sb->turn][0];
+        first[k++] = killers[sb->turn][1];
+    }
+    if (params.countermove_depth >= 0 &&
+        sb->turn >= params.countermove_depth && sb->last >= 0) {
+        first[k++] = countermoves[sb->player][sb->last];
+    }
+    for (i = 0; i < k; i++) {
+        if (first[i] >= 0 && !(seen & (1u << first[i]))) {
+            seen |= 1u << first[i];
+            moves[n++] = first[i];
+        }
+    }
+
+    for (i = 0; i < sb->x; i++) {
+        rest[i] = i;
+    }
+    if (sb->turn <= params.reorder_depth) {
+        reorder_moves(sb, rest);
+    }
+    for (i = 0; i < sb->x; i++) {
+        if (!(seen & (1u << rest[i]))) {
+            moves[n++] = rest[i];
+        }
+    }
 }
 
 /* Adjust score for given column. */
-void score_move(board *board, int col)
+void score_move(search_board *sb, int col)
 {
-    move_scores[board->turn][col] += 1;
+    move_scores[sb->turn][col] += 1;
 }
     
+/* Returns the steps the AI took since the last init_ai(). */
+unsigned long ai_steps()
+{
+    return ai_counter;
+}
+
+/* Writes the move scores to f. */
+void save_reorder(FILE *f)
+{
+    fwrite(move_scores, sizeof(move_scores), 1, f);
+}
+
+/* Reads move scores written by save_reorder(). Returns 0 on success, -1
+ * otherwise. */
+int load_reorder(FILE *f)
+{
+    return fread(move_scores, sizeof(move_scores), 1, f) == 1 ? 0 : -1;
+}
+
 /* Initialize everything needed for AI operation. */
 void init_ai(board *board)
 {
     ai_counter = 0;
-    init_hash();
+    init_params(board->size);
+    init_hash(board->size);
+    init_eval(board->size);
+    init_endgame(board->size);
+    init_tss(board->size);
     init_reorder(board->size);
+    trace_until = trace_depth();
 }
@@ -5,7 +5,11 @@
 #ifndef YONMOKUNARABE_AI_H
 #define YONMOKUNARABE_AI_H
 
+#include <stdio.h>
 #include "board.h"
+#include "trace.h"
+
+struct solution_db;
                               
 #define AI_DEBUG 0 /* print AI debug info */
 #define DEBUG_DEPTH 10 /* don't print info after that depth */
@@ -14,9 +18,12 @@
 #define MAX_COLS  16
 #define MAX_TURNS 60
 
-#define REORDER_DEPTH 10 /* Moves are only reordered until this depth. Set to 0
-                            to (kinda) disable reordering. Typically, the last
-                            turns aren't worth the sorting trouble. */
+
+#define POLL_INTERVAL (1<<20) /* Check timers every that many steps. Must be a
+                                 power of 2. */
+#define PROGRESS_EVERY 10     /* Default seconds between progress reports. */
+#define USE_ITERATIVE 1       /* alpha_beta() keeps its boards on an explicit
+                                 stack instead of the C stack. */
 
 typedef enum { 
     UNKNOWN    = -3,
@@ -27,13 +34,74 @@ typedef enum {
     WIN        = 2
 } board_state;
 
+/* Progress of a search at the root. Proven moves aren't searched again. */
+typedef struct {
+    board_state res;               /* best result so far, UNKNOWN if none */
+    board_state value[MAX_COLS];   /* result of each root move, UNKNOWN until
+                                      it is proven */
+    unsigned long nodes[MAX_COLS]; /* steps spent on each proven root move */
+} root_progress;
+
+/* One board of an iterative search, see search_run(). */
+typedef struct {
+    board_state alpha;
+    board_state beta;
+    board_state res;
+    board_state hash;       /* bound from hash or parity */
+    int stage;              /* where the search of this board continues */
+    int col;                /* move searched right now */
+    int j;                  /* index of the next move to try */
+    int hash_move;          /* best move stored in the hash */
+    int last;               /* move that led to this board, -1 if unknown */
+    int best_move;
+    int possible_moves;     /* moves not searched yet */
+    int moves[MAX_COLS];    /* all moves, in the order to try them */
+    trace_record rec;
+} search_frame;
+
+/* An alpha-beta search that can be suspended between any two boards. Frames
+ * are indexed by ply, so the frame of the current board is
+ * frames[sb->turn]. */
+typedef struct {
+    search_board *sb;       /* must not be touched until the search is done */
+    int root;               /* ply of the root */
+    board_state res;        /* UNKNOWN until the search is done */
+    unsigned long steps;    /* boards entered so far */
+    search_frame frames[MAX_TURNS+1];
+} search_stack;
+
 board_state solve(board *board);
+board_state continue_solve(board *board, root_progress *progress);
+board_state search_root(search_board *sb, root_progress *progress);
+void init_root_progress(root_progress *progress);
+void set_checkpoint(const char *file, double every);
+void set_progress(FILE *out, double every);
+const char *state_name(board_state res);
+void print_result(board_state res);
 int recommend_move(board *board);
+void set_db(struct solution_db *db); /* see db.h */
+board_state analyze(board *board, board_state values[]);
 void init_ai(board *board);
+unsigned long ai_steps();
 void init_reorder(board_size *size);
-board_state alpha_beta(board *board, board_state alpha, board_state beta);
-void reorder_moves(board *board, int moves[]);
-void score_move(board *board, int col);
+void reset_reorder(board_size *size);
+board_state alpha_beta(search_board *sb, board_state alpha, board_state beta);
+board_state recursive_alpha_beta(search_board *sb, board_state alpha,
+                                 board_state beta);
+void init_search_stack(search_stack *st, search_board *sb,
+                       board_state alpha, board_state beta);
+board_state search_run(search_stack *st, unsigned long steps);
+board_state search_step(search_stack *st);
+int search_enter(search_board *sb, search_frame *f);
+int search_leave(search_board *sb, search_frame *f, board_state temp);
+int search_take(search_board *sb, search_frame *f, board_state temp);
+int search_next(search_board *sb, search_frame *f);
+void search_finish(search_board *sb, search_frame *f);
+void reorder_moves(search_board *sb, int moves[]);
+void order_moves(search_board *sb, int hash_move, int moves[]);
+void score_move(search_board *sb, int col);
+void save_reorder(FILE *f);
+int load_reorder(FILE *f);
 
 #endif /* end of include guard: YONMOKUNARABE_AI_H */
 
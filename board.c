@@ -11,7 +11,10 @@
 
 /* Array of Zobrist numbers. 4 bits for each coordinate and 1 bit for the
  * player. */
-static uint64_t zobrist[1<<9];
+uint64_t zobrist[1<<9];
+
+/* Masks of the board size last passed to init_masks(). */
+board_masks masks;
 
 /* Initialize board. Just allocate and pass the args. */
 void init_board(board *board, board_size *size)
@@ -33,9 +36,7 @@ void init_board(board *board, board_size *size)
     board->bitmap[WHITE] = 0;
     board->bitmap[BLACK] = 0;
     board->hash          = 0;
-#if USE_SYMMETRY == 1
     board->sym_hash      = 0;
-#endif
     
     if ((board->height_map = malloc(sizeof(int) * board->size->x)) == NULL)
         abort();
@@ -58,6 +59,19 @@ void destroy_board(board *board)
     free(board->history);
 }
 
+/* Initializes dst as an independent copy of src, sharing only the size. Free
+ * it with destroy_board() like any other board. */
+void copy_board(board *dst, board *src)
+{
+    *dst = *src;
+    if ((dst->height_map = malloc(sizeof(int) * src->size->x)) == NULL)
+        abort();
+    memcpy(dst->height_map, src->height_map, sizeof(int) * src->size->x);
+    if ((dst->history = malloc(sizeof(int) * src->max_turns)) == NULL)
+        abort();
+    memcpy(dst->history, src->history, sizeof(int) * src->max_turns);
+}
+
 /* Return bit from bitmap matching coordinates x, y.
  * Note that there is an intentional free bit between each column to enable fast
  * detection of won games.
@@ -112,7 +126,7 @@ void print_board(board *board)
         printf("n/a");
     } else {
         for (i=0; i < board->turn; i++) {
-            printf("%c", board->history[i] + '0');
+            printf("%c", move_char(board->history[i]));
         }
     }
     printf(", Zobrist: %d", (int)board->hash);
@@ -143,18 +157,10 @@ int move(board *board, int col)
                 col, 
                 board->height_map[col], 
                 board->player);
-#if USE_SYMMETRY == 1
-#if SYMMETRY_CUT_OFF > -1
-        if (board->turn <= SYMMETRY_CUT_OFF) {
-#endif
-            board->sym_hash ^= zobrist_number(
-                    board->size->x - col, 
-                    board->height_map[col], 
-                    board->player);
-#if SYMMETRY_CUT_OFF > -1
-        }
-#endif
-#endif
+        board->sym_hash ^= zobrist_number(
+                board->size->x - col, 
+                board->height_map[col], 
+                board->player);
         /* move */
         bit = bitpos(board, col, board->height_map[col]);
         board->bitmap[board->player] ^= bit;
@@ -204,24 +210,16 @@ int undo(board *board, int n)
                 col, 
                 board->height_map[col], 
                 board->player);
-#if USE_SYMMETRY == 1
-#if SYMMETRY_CUT_OFF > -1
-        if (board->turn <= SYMMETRY_CUT_OFF) {
-#endif
-            board->sym_hash ^= zobrist_number(
-                    board->size->x - col, 
-                    board->height_map[col], 
-                    board->player);
-#if SYMMETRY_CUT_OFF > -1
-        }
-#endif
-#endif
+        board->sym_hash ^= zobrist_number(
+                board->size->x - col, 
+                board->height_map[col], 
+                board->player);
     
 #if MOVE_DEBUG == 1
         printf("After:\n");
         print_board(board);
 #endif
-        return 0;
+        n -= 1;
     }
 
     if (n != 0) {
@@ -235,38 +233,10 @@ int undo(board *board, int n)
 /* Returns 1 if given player has won, 0 otherwise. */
 int has_won(board *board, players player)
 {
-    uint64_t pos, x;
-    
     /* Note: This would be faster if the size were already known at compile
      * time. ;)
      */
-    pos = board->bitmap[player]; 
-
-    /* - */
-    x = pos & (pos >> (board->size->y+1));
-    if (x & (x >> (2*(board->size->y+1)))) {
-        return 1;
-    }
-
-    /* / */
-    x = pos & (pos >> (board->size->y+2));
-    if (x & (x >> (2*(board->size->y+2)))) {
-        return 1;
-    }
-    
-    /* \ */
-    x = pos & (pos >> board->size->y);
-    if (x & (x >> (2*board->size->y))) {  
-        return 1;
-    }
-    
-    /* | */
-    x = pos & (pos >> 1);
-    if (x & (x >> 2)) {  
-        return 1;
-    }
-    
-    return 0;
+    return bitmap_has_won(board->bitmap[player], board->size->y);
 }
 
 /* Resets board. Like undo. */
@@ -300,14 +270,32 @@ void fast_undo(board *board, int col, players player)
     fast_move(board, col, player);
 }
 
-/* Like move, but allows multiple moves at once. */
-/* #TODO: Should catch errors and allow moves > 9. */
-void complex_move(board *board, char s[]) {
+/* Returns the character of column col in move strings: 0-9, then a-f. */
+char move_char(int col)
+{
+    return col < 10 ? '0' + col : 'a' + col - 10;
+}
+
+/* Returns the column of character c in move strings or -1 if there is none. */
+int char_move(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/* Like move, but allows multiple moves at once, see move_char(). Stops at the
+ * first illegal move and returns -1, 0 if all moves were made. */
+int complex_move(board *board, char s[]) {
     int i;
     char c;
     for (i=0; (c=s[i]); i++) {
-        move(board, c-'0');
+        if (move(board, char_move(c)) < 0)
+            return -1;
     }
+    return 0;
 }
 
 /* Returns the Zobrist number for the given position and player. */
@@ -316,19 +304,124 @@ uint64_t zobrist_number(int x, int y, players player)
     return zobrist[x + (y<<4) + (player << 8)];
 }
 
+/* Returns the next number from a SplitMix64 generator. rand() only gives us 31
+ * random bits on glibc, which made the keys cluster in the hash, so we
+ * roll our own full 64-bit generator instead. */
+uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z;
+
+    z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
 /* Initializes Zobrist array. */
 void init_zobrist()
 {
     int x, y;
     players p;
-
-    srand(108);
+    uint64_t state = 108;
 
     for (x = 0; x < 16; x++) {
         for (y = 0; y < 16; y++) {
             for (p = 0; p < 2; p++) {
-                zobrist[x + (y<<4) + (p <<8)] = (uint64_t) rand();                
+                zobrist[x + (y<<4) + (p <<8)] = splitmix64(&state);
+            }
+        }
+    }
+}
+
+/* Sets up masks for boards of the given size. Does nothing if they already
+ * belong to it. */
+void init_masks(board_size *size)
+{
+    unsigned int x, i;
+    uint64_t col;
+
+    if (masks.x == size->x && masks.y == size->y) {
+        return;
+    }
+    masks.x       = size->x;
+    masks.y       = size->y;
+    masks.col_len = size->y + 1;
+    masks.column  = ((uint64_t)1 << masks.col_len) - 1;
+    masks.board   = masks.bottom = 0;
+    col = ((uint64_t)1 << size->y) - 1;
+    for (x = 0; x < size->x; x++) {
+        masks.bottom |= (uint64_t)1 << (x * masks.col_len);
+        masks.board  |= col << (x * masks.col_len);
+    }
+    /* Center columns take part in most lines, so try them first. */
+    for (i = 0; i < size->x; i++) {
+        x = (i & 1) ? size->x/2 - (i+1)/2 : size->x/2 + i/2;
+        masks.cols[i]      = col << (x * masks.col_len);
+        masks.col_index[i] = x;
+    }
+}
+
+/* Converts board into a search board. Hashes are recalculated from scratch. */
+void init_search_board(search_board *sb, board *board)
+{
+    int x, y;
+    players p;
+
+    memset(sb, 0, sizeof(search_board));
+    sb->bitmap[WHITE] = board->bitmap[WHITE];
+    sb->bitmap[BLACK] = board->bitmap[BLACK];
+    sb->mask          = board->bitmap[WHITE] | board->bitmap[BLACK];
+    sb->heights       = 0;
+    sb->hash          = 0;
+    sb->sym_hash      = 0;
+    sb->x             = board->size->x;
+    sb->y             = board->size->y;
+    sb->player        = board->player;
+    sb->turn          = board->turn;
+    sb->max_turns     = board->max_turns;
+    sb->last          = board->turn > 0 ? board->history[board->turn-1] : -1;
+
+    for (x = 0; x < board->size->x; x++) {
+        sb->heights |= (uint64_t)board->height_map[x] << (x << 2);
+        for (y = 0; y < board->height_map[x]; y++) {
+            p = blocked_by(board, x, y, WHITE) ? WHITE : BLACK;
+            sb->hash     ^= zobrist_number(x, y, p);
+            sb->sym_hash ^= zobrist_number(board->size->x - x, y, p);
+        }
+    }
+}
+
+/* Sets sb to the empty board of size. Unlike init_board(), this doesn't set
+ * up the Zobrist numbers, so call init_zobrist() once before. */
+void init_empty_search_board(search_board *sb, board_size *size)
+{
+    memset(sb, 0, sizeof(search_board));
+    sb->x         = size->x;
+    sb->y         = size->y;
+    sb->player    = WHITE;
+    sb->max_turns = size->x * size->y;
+    sb->last      = -1;
+}
+
+/* Pretty-print search board. */
+void print_search_board(search_board *sb)
+{
+    int x, y;
+    uint64_t bit;
+
+    for (y = sb->y - 1; y >= 0; y--) {
+        for (x = 0; x < sb->x; x++) {
+            bit = (uint64_t)1 << (x * (sb->y+1) + y);
+            if (sb->bitmap[WHITE] & bit) {
+                printf("W");
+            } else if (sb->bitmap[BLACK] & bit) {
+                printf("B");
+            } else {
+                printf(".");
             }
         }
+        printf("\n");
     }
+    printf("turn: %d, player: %c, Zobrist: %d\n",
+           sb->turn, "WB"[sb->player], (int)sb->hash);
 }
@@ -8,11 +8,6 @@
 #include <stdint.h>
 
 #define MOVE_DEBUG 0 /* print debug info when making moves */
-#define USE_SYMMETRY 1 /* Use additional symmetric hash? This is generally very
-                          slow and not worth it. However, when doing move
-                          reordering, it may be beneficial. */
-#define SYMMETRY_CUT_OFF 10 /* Ignore symmetry hash after that many turns. Set
-                               to -1 to turn off cut-off. */
 
 typedef struct {
     unsigned int x;
@@ -28,9 +23,7 @@ typedef struct {
     unsigned int *height_map;  /* height of each column */
     int *history;              /* move history */
     uint64_t hash;             /* incremental hash */
-#if USE_SYMMETRY == 1
     uint64_t sym_hash;         /* symmetrical hash */
-#endif
 } board;
 
 typedef enum { 
@@ -38,8 +31,48 @@ typedef enum {
     BLACK = 1
 } players;
 
+/* Compact board used by the search itself. It needs no allocation, is smaller
+ * than a cache line (though not aligned to one) and moves are made and unmade
+ * without any branches. There are no sanity checks whatsoever, so only make
+ * legal moves. Convert a board into it via init_search_board() at the root of
+ * a search. */
+typedef struct {
+    uint64_t bitmap[2];        /* occupied positions for each player */
+    uint64_t mask;             /* occupied positions of both players */
+    uint64_t heights;          /* height of each column, 4 bits per column */
+    uint64_t hash;             /* incremental hash */
+    uint64_t sym_hash;         /* symmetrical hash */
+    unsigned char x;           /* width of the board */
+    unsigned char y;           /* height of the board */
+    unsigned char player;      /* current player */
+    unsigned char turn;        /* current turn */
+    unsigned char max_turns;   /* maximal number of playable turns */
+    signed char last;          /* last move made, -1 if unknown; search_undo()
+                                  leaves it alone */
+} search_board;
+
+/* Zobrist numbers, 4 bits for each coordinate and 1 bit for the player. */
+extern uint64_t zobrist[1<<9];
+#define ZOBRIST(X, Y, P) (zobrist[(X) + ((Y)<<4) + ((P)<<8)])
+
+/* Masks for bitmaps of one board size, shared by the modules that work on
+ * bitmaps alone. Set up via init_masks(). */
+typedef struct {
+    uint64_t board;            /* all fields of the board */
+    uint64_t bottom;           /* lowest field of each column */
+    uint64_t column;           /* all bits of column 0, with separator */
+    uint64_t cols[16];         /* fields of each column, center first */
+    int col_index[16];         /* column of each entry in cols */
+    unsigned int x;            /* width of the board */
+    unsigned int y;            /* height of the board */
+    unsigned int col_len;      /* bits per column, including the separator */
+} board_masks;
+
+extern board_masks masks;
+
 void init_board(board *board, board_size *size);
 void destroy_board(board *board);
+void copy_board(board *dst, board *src);
 int blocked(board *board, int x, int y);
 int blocked_by(board *board, int x, int y, players player);
 void print_board(board *board);
@@ -50,9 +83,127 @@ int reset(board *board);
 void fast_move(board *board, int col, players player);
 void fast_undo(board *board, int col, players player);
 int column_free(board *board, int col);
-void complex_move(board *board, char s[]);
+char move_char(int col);
+int char_move(char c);
+int complex_move(board *board, char s[]);
 uint64_t zobrist_number(int x, int y, players player);
 void init_zobrist();
+void init_masks(board_size *size);
+uint64_t splitmix64(uint64_t *state);
+void init_search_board(search_board *sb, board *board);
+void init_empty_search_board(search_board *sb, board_size *size);
+void print_search_board(search_board *sb);
+
+/* Returns 1 if the stones in pos contain four in a row on a board of height
+ * y, 0 otherwise. */
+static inline int bitmap_has_won(uint64_t pos, unsigned int y)
+{
+    uint64_t x;
+
+    x = pos & (pos >> (y+1));         /* - */
+    if (x & (x >> (2*(y+1))))
+        return 1;
+    x = pos & (pos >> (y+2));         /* / */
+    if (x & (x >> (2*(y+2))))
+        return 1;
+    x = pos & (pos >> y);             /* \ */
+    if (x & (x >> (2*y)))
+        return 1;
+    x = pos & (pos >> 1);             /* | */
+    return (x & (x >> 2)) != 0;
+}
+
+/* Returns all fields that would complete a line for the stones in pos on a
+ * board of height y. This includes occupied fields and fields outside the
+ * board, so mask the result. */
+static inline uint64_t bitmap_winning_fields(uint64_t pos, unsigned int y)
+{
+    uint64_t r, p;
+    unsigned int d[3], i;
+
+    /* | */
+    r = (pos << 1) & (pos << 2) & (pos << 3);
+
+    d[0] = y + 1; /* - */
+    d[1] = y + 2; /* / */
+    d[2] = y;     /* \ */
+    for (i = 0; i < 3; i++) {
+        p  = (pos << d[i]) & (pos << 2*d[i]);
+        r |= p & (pos << 3*d[i]);
+        r |= p & (pos >> d[i]);
+        p  = (pos >> d[i]) & (pos >> 2*d[i]);
+        r |= p & (pos << d[i]);
+        r |= p & (pos >> 3*d[i]);
+    }
+    return r;
+}
+
+/* Returns the height of column col. */
+static inline unsigned int search_height(search_board *sb, int col)
+{
+    return (sb->heights >> (col << 2)) & 15;
+}
+
+/* Returns 1 if column is playable, 0 otherwise. */
+static inline int search_column_free(search_board *sb, int col)
+{
+    return search_height(sb, col) < sb->y;
+}
+
+/* Returns the bit the next stone in column col would occupy. */
+static inline uint64_t search_move_bit(search_board *sb, int col)
+{
+    return (uint64_t)1 << (col * (sb->y+1) + search_height(sb, col));
+}
+
+/* Returns 1 if player would win by playing in column col, 0 otherwise. */
+static inline int search_wins_with(search_board *sb, int col, players player)
+{
+    return bitmap_has_won(sb->bitmap[player] | search_move_bit(sb, col), sb->y);
+}
+
+/* Returns all fields that would complete a line for player, occupied or not.
+ * Test free columns against it with search_move_bit(). */
+static inline uint64_t search_wins(search_board *sb, players player)
+{
+    return bitmap_winning_fields(sb->bitmap[player], sb->y);
+}
+
+/* Make move in given column. The column must be free. */
+static inline void search_move(search_board *sb, int col)
+{
+    unsigned int h;
+    uint64_t bit;
+
+    h   = search_height(sb, col);
+    bit = (uint64_t)1 << (col * (sb->y+1) + h);
+    sb->bitmap[sb->player] ^= bit;
+    sb->mask               ^= bit;
+    sb->heights            += (uint64_t)1 << (col << 2);
+    sb->hash               ^= ZOBRIST(col, h, sb->player);
+    /* Always updated, get_hash() decides whether to use it. */
+    sb->sym_hash           ^= ZOBRIST(sb->x - col, h, sb->player);
+    sb->player             ^= 1;
+    sb->turn               += 1;
+    sb->last                = col;
+}
+
+/* Unmake the last move, which must have been made in column col. */
+static inline void search_undo(search_board *sb, int col)
+{
+    unsigned int h;
+    uint64_t bit;
+
+    sb->player             ^= 1;
+    sb->turn               -= 1;
+    sb->heights            -= (uint64_t)1 << (col << 2);
+    h   = search_height(sb, col);
+    bit = (uint64_t)1 << (col * (sb->y+1) + h);
+    sb->bitmap[sb->player] ^= bit;
+    sb->mask               ^= bit;
+    sb->hash               ^= ZOBRIST(col, h, sb->player);
+    sb->sym_hash           ^= ZOBRIST(sb->x - col, h, sb->player);
+}
 
 #endif /* end of include guard: YONMOKUNARABE_BOARD_H */
 
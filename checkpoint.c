@@ -0,0 +1,130 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Checkpoints of long solves. A checkpoint holds the board, the results of
+ * the root moves proven so far, the move scores and the whole hash, so that
+ * finished subtrees aren't searched again after a resume. The format is raw
+ * native-endian binary and only meant to be read on the same machine:
+ *
+ *     magic, version, width, height, turn, moves[turn],
+ *     root_progress, move scores, hash entries
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ai.h"
+#include "board.h"
+#include "checkpoint.h"
+#include "hash.h"
+#include "timer.h"
+
+/* Saves checkpoint of board and its progress. The file is replaced
+ * atomically, so an interrupted write keeps the old checkpoint. Returns 0 on
+ * success, -1 otherwise. */
+int save_checkpoint(const char *file, board *board, root_progress *progress)
+{
+    FILE *f;
+    char tmp[FILENAME_MAX];
+    uint32_t header[4];
+    unsigned char moves[MAX_TURNS];
+    unsigned long n;
+    double start = get_time();
+    int i, ok;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    if ((f = fopen(tmp, "wb")) == NULL) {
+        printf("Can't write checkpoint %s.\n", tmp);
+        return -1;
+    }
+
+    header[0] = CHECKPOINT_VERSION;
+    header[1] = board->size->x;
+    header[2] = board->size->y;
+    header[3] = board->turn;
+    for (i = 0; i < board->turn; i++) {
+        moves[i] = board->history[i];
+    }
+    fwrite(CHECKPOINT_MAGIC, 4, 1, f);
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(moves, 1, board->turn, f);
+    fwrite(progress, sizeof(root_progress), 1, f);
+    save_reorder(f);
+    n = save_hash(f);
+
+    ok = !ferror(f);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, file) != 0) {
+        printf("Can't write checkpoint %s.\n", file);
+        remove(tmp);
+        return -1;
+    }
+    printf("Checkpoint: %lu hash entries saved to %s in %.2fs.\n",
+           n, file, get_time() - start);
+    return 0;
+}
+
+/* Continues a solve from a checkpoint file. Prints the result like solve()
+ * and returns it, or UNKNOWN if the checkpoint can't be read. */
+board_state resume_solve(const char *file)
+{
+    FILE *f;
+    char magic[4];
+    uint32_t header[4];
+    unsigned char moves[MAX_TURNS];
+    root_progress progress;
+    board_size size;
+    board board;
+    board_state res = UNKNOWN;
+    long n;
+    int i, proven;
+
+    if ((f = fopen(file, "rb")) == NULL) {
+        printf("Can't open checkpoint %s.\n", file);
+        return UNKNOWN;
+    }
+    if (fread(magic, 4, 1, f) != 1 || memcmp(magic, CHECKPOINT_MAGIC, 4) ||
+        fread(header, sizeof(header), 1, f) != 1 ||
+        header[0] != CHECKPOINT_VERSION ||
+        /* Same limits as the bitmaps: 4 bits per height, 64 bits per board. */
+        header[1] < 4 || header[1] > MAX_COLS ||
+        header[2] < 4 || header[2] > 15 ||
+        header[1] * (header[2] + 1) > 64 ||
+        header[3] > header[1] * header[2] ||
+        fread(moves, 1, header[3], f) != header[3] ||
+        fread(&progress, sizeof(progress), 1, f) != 1) {
+        printf("Broken checkpoint %s.\n", file);
+        fclose(f);
+        return UNKNOWN;
+    }
+
+    size.x = header[1];
+    size.y = header[2];
+    init_board(&board, &size);
+    for (i = 0; i < header[3]; i++) {
+        if (moves[i] >= size.x || !column_free(&board, moves[i])) {
+            printf("Broken checkpoint %s.\n", file);
+            fclose(f);
+            destroy_board(&board);
+            return UNKNOWN;
+        }
+        move(&board, moves[i]);
+    }
+    printf("Resuming %dx%d board from %s.\n", size.x, size.y, file);
+    print_board(&board);
+
+    init_ai(&board);
+    if (load_reorder(f) < 0 || (n = load_hash(f)) < 0) {
+        printf("Broken checkpoint %s.\n", file);
+    } else {
+        for (i = proven = 0; i < size.x; i++) {
+            proven += (progress.value[i] != UNKNOWN);
+        }
+        printf("Loaded %ld hash entries, %d root moves proven.\n", n, proven);
+        res = continue_solve(&board, &progress);
+    }
+    fclose(f);
+    destroy_board(&board);
+    return res;
+}
@@ -0,0 +1,18 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_CHECKPOINT_H
+#define YONMOKUNARABE_CHECKPOINT_H
+
+#include "ai.h"
+#include "board.h"
+
+#define CHECKPOINT_MAGIC "YMKC"
+#define CHECKPOINT_VERSION 3
+#define CHECKPOINT_EVERY 600 /* Default seconds between checkpoints. */
+
+int save_checkpoint(const char *file, board *board, root_progress *progress);
+board_state resume_solve(const char *file);
+
+#endif /* end of include guard: YONMOKUNARABE_CHECKPOINT_H */
@@ -9,5 +9,9 @@ extern short verbose;
 #define min(A, B) ((A) < (B) ? (A) : (B))
 #define max(A, B) ((A) > (B) ? (A) : (B))
 
+/* Every thread gets its own copy. Used for counters and move order tables, so
+ * the threads of ybw_solve() don't write to the same memory. */
+#define THREAD_LOCAL __thread
+
 #endif /* end of include guard: YONMOKUNARABE_COMMON_H */
 
@@ -0,0 +1,211 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Benchmark corpora of random positions. Each line of a corpus file holds the
+ * board size, the moves leading to the position ("-" for none) and its value
+ * for the player to move as certified by minimax() ("?" if too large):
+ *
+ *     # comment
+ *     5x4 0123341 draw
+ *
+ * Columns above 9 are written as a-f, see move_char().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "corpus.h"
+#include "timer.h"
+
+static const char *state_names[] = { "lose", "?", "draw", "?", "win" };
+
+/* Plain minimax, returns the value for the player to move. No hash, no
+ * ordering, no threat detection, nothing clever. Only used to certify the
+ * results of the real search. */
+board_state minimax(board *board)
+{
+    board_state res = LOSE;
+    board_state temp;
+    int i;
+
+    if (board->turn >= board->max_turns) {
+        return DRAW;
+    }
+
+    for (i = 0; i < board->size->x && res != WIN; i++) {
+        if (column_free(board, i)) {
+            move(board, i);
+            if (has_won(board, board->player^1)) {
+                temp = WIN;
+            } else {
+                temp = -minimax(board);
+            }
+            undo(board, 1);
+            res = max(res, temp);
+        }
+    }
+    return res;
+}
+
+/* Plays random moves until ply is reached. Returns 0 if the game ended on the
+ * way, 1 otherwise. */
+int random_position(board *board, int ply, uint64_t *state)
+{
+    int col;
+
+    reset(board);
+    while (board->turn < ply) {
+        do {
+            col = splitmix64(state) % board->size->x;
+        } while (!column_free(board, col));
+        move(board, col);
+        if (has_won(board, board->player^1)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Parses a corpus line into size, the moves and the certified value (UNKNOWN
+ * if there is none). moves must hold CORPUS_MAX_LINE characters. Returns 1
+ * for a position, 0 for comments and empty lines and -1 if line is broken. */
+int parse_corpus_line(const char *line, board_size *size, char *moves,
+                      board_state *value)
+{
+    char name[16];
+    int i;
+
+    if (line[0] == '#' || line[0] == '\n') {
+        return 0;
+    }
+    if (sscanf(line, "%ux%u %127s %15s", &size->x, &size->y,
+               moves, name) != 4) {
+        return -1;
+    }
+    if (strcmp(moves, "-") == 0) {
+        moves[0] = '\0';
+    }
+    *value = UNKNOWN;
+    for (i = 0; i <= WIN - LOSE; i += 2) {
+        if (strcmp(name, state_names[i]) == 0) {
+            *value = i + LOSE;
+        }
+    }
+    return 1;
+}
+
+/* Writes a corpus line for the position after the n given moves on a board of
+ * size. value is the certified value or UNKNOWN. */
+void write_corpus_line(FILE *out, board_size *size, int moves[], int n,
+                       board_state value)
+{
+    int i;
+
+    fprintf(out, "%dx%d ", size->x, size->y);
+    if (n == 0) {
+        fprintf(out, "-");
+    }
+    for (i = 0; i < n; i++) {
+        fputc(move_char(moves[i]), out);
+    }
+    fprintf(out, " %s\n", value == UNKNOWN ? "?" : state_names[value - LOSE]);
+}
+
+/* Writes count random, unfinished positions of size with min_ply to max_ply
+ * moves to out. The same seed always gives the same corpus. */
+void generate_corpus(FILE *out, board_size *size, int count,
+                     int min_ply, int max_ply, uint64_t seed)
+{
+    board board;
+    board_state res;
+    uint64_t state = seed;
+    int n, ply;
+
+    init_board(&board, size);
+    max_ply = min(max_ply, (int)board.max_turns - 1);
+    min_ply = min(min_ply, max_ply);
+
+    fprintf(out, "# %dx%d, %d positions, plies %d-%d, seed %lu\n",
+            size->x, size->y, count, min_ply, max_ply, (unsigned long)seed);
+    for (n = 0; n < count; n++) {
+        ply = min_ply + splitmix64(&state) % (max_ply - min_ply + 1);
+        while (!random_position(&board, ply, &state))
+            ;
+
+        res = UNKNOWN;
+        if (board.max_turns - board.turn <= ORACLE_MAX_EMPTY) {
+            res = minimax(&board);
+        }
+        write_corpus_line(out, size, board.history, board.turn, res);
+    }
+    destroy_board(&board);
+}
+
+/* Solves each position in file with alpha_beta and compares the result with
+ * the certified value. Returns the number of mismatches or -1 if the file
+ * couldn't be read. */
+int replay_corpus(const char *file, board_size *only, corpus_stats *stats)
+{
+    FILE *in;
+    char line[CORPUS_MAX_LINE], moves[CORPUS_MAX_LINE];
+    board_size size;
+    board board;
+    search_board sb;
+    board_state res, expected;
+    double start;
+    int n;
+
+    memset(stats, 0, sizeof(corpus_stats));
+    if ((in = fopen(file, "r")) == NULL) {
+        printf("Can't open corpus %s.\n", file);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if ((n = parse_corpus_line(line, &size, moves, &expected)) <= 0) {
+            if (n < 0) {
+                printf("Broken corpus line: %s", line);
+            }
+            continue;
+        }
+        if (only != NULL && (size.x != only->x || size.y != only->y)) {
+            continue;
+        }
+
+        init_board(&board, &size);
+        complex_move(&board, moves);
+        init_ai(&board);
+        init_search_board(&sb, &board);
+
+        start = get_time();
+        res = alpha_beta(&sb, LOSE, WIN);
+        stats->time  += get_time() - start;
+        stats->steps += ai_steps();
+        stats->positions += 1;
+
+        if (expected != UNKNOWN) {
+            stats->certified += 1;
+            if (res != expected) {
+                stats->mismatches += 1;
+                printf("Mismatch: %dx%d %s is %s, alpha-beta says %d.\n",
+                       size.x, size.y, moves, state_name(expected), res);
+            }
+        }
+        destroy_board(&board);
+    }
+    fclose(in);
+    return stats->mismatches;
+}
+
+/* Prints corpus replay results. */
+void print_corpus_stats(corpus_stats *stats)
+{
+    printf("Positions: %lu, certified: %lu, mismatches: %lu, steps: %lu, "
+           "time: %.3fs (%.0f steps/s).\n",
+           stats->positions, stats->certified, stats->mismatches,
+           stats->steps, stats->time,
+           stats->steps / (stats->time > 0 ? stats->time : 1e-9));
+}
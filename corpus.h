@@ -0,0 +1,36 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_CORPUS_H
+#define YONMOKUNARABE_CORPUS_H
+
+#include <stdio.h>
+#include "ai.h"
+#include "board.h"
+
+#define ORACLE_MAX_EMPTY 14 /* Only certify positions with at most that many
+                               empty fields. Minimax has no table, so anything
+                               more takes ages. */
+#define CORPUS_MAX_LINE 128
+
+typedef struct {
+    unsigned long positions;  /* positions replayed */
+    unsigned long certified;  /* positions with a known value */
+    unsigned long mismatches; /* certified positions alpha_beta got wrong */
+    unsigned long steps;      /* alpha_beta steps for all positions */
+    double time;              /* seconds spent in alpha_beta */
+} corpus_stats;
+
+board_state minimax(board *board);
+int random_position(board *board, int ply, uint64_t *state);
+int parse_corpus_line(const char *line, board_size *size, char *moves,
+                      board_state *value);
+void write_corpus_line(FILE *out, board_size *size, int moves[], int n,
+                       board_state value);
+void generate_corpus(FILE *out, board_size *size, int count,
+                     int min_ply, int max_ply, uint64_t seed);
+int replay_corpus(const char *file, board_size *only, corpus_stats *stats);
+void print_corpus_stats(corpus_stats *stats);
+
+#endif /* end of include guard: YONMOKUNARABE_CORPUS_H */
@@ -0,0 +1,622 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Strong solutions: the value of every reachable position of a board size.
+ *
+ * Positions are enumerated one ply at a time. Children of all positions of a
+ * ply are written to sorted run files of at most DB_CHUNK records, which are
+ * then merged into the sorted, duplicate free positions of the next ply.
+ * Values are backed up the same way, starting at the last ply: the children of
+ * a ply are sorted by key and merged with the values of the next ply, the
+ * results sorted by parent and reduced to the best one. So no step needs more
+ * memory than two chunks, only disk space.
+ *
+ * A position is identified by the key white + mask + bottom, which is unique
+ * for a board size. Mirrored positions share the smaller key. Finished games
+ * aren't stored, the move leading to them already knows their value.
+ *
+ * The database file holds DB_MAGIC, version, width, height and number of
+ * plies (uint32_t each), the number of positions of each ply (uint64_t), and
+ * then for each ply its sorted keys (uint64_t) followed by their values, 2
+ * bits each (0 lose, 1 draw, 2 win for the player to move).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "db.h"
+#include "timer.h"
+
+typedef struct {
+    uint64_t key;
+    uint64_t data;
+} db_record;
+
+/* Sorts any number of records through run files. */
+typedef struct {
+    char base[FILENAME_MAX + 32]; /* run files are called base.N */
+    db_record *buf;           /* records of the current run */
+    size_t used;              /* records in buf */
+    size_t pos;               /* next record of buf, if there are no runs */
+    int runs;                 /* run files written */
+    FILE *files[DB_MAX_RUNS]; /* open run files while merging */
+    db_record heads[DB_MAX_RUNS]; /* next record of each run file */
+    int live[DB_MAX_RUNS];    /* does the run file have records left? */
+} db_sorter;
+
+/* Returns the key of the position with white and all stones. */
+static inline uint64_t make_key(uint64_t white, uint64_t mask)
+{
+    return white + mask + masks.bottom;
+}
+
+/* Splits key back into white and all stones. */
+static void split_key(uint64_t key, uint64_t *white, uint64_t *mask)
+{
+    uint64_t col, top;
+    unsigned int x;
+
+    *white = *mask = 0;
+    for (x = 0; x < masks.x; x++) {
+        col = (key >> (x * masks.col_len)) & masks.column;
+        for (top = (uint64_t)1 << masks.y; !(col & top); top >>= 1)
+            ;
+        *mask  |= (top - 1) << (x * masks.col_len);
+        *white |= (col - top) << (x * masks.col_len);
+    }
+}
+
+/* Returns key with its columns in reverse order. */
+static uint64_t mirror_key(uint64_t key)
+{
+    uint64_t res = 0;
+    unsigned int x;
+
+    for (x = 0; x < masks.x; x++) {
+        res |= ((key >> (x * masks.col_len)) & masks.column)
+               << ((masks.x - 1 - x) * masks.col_len);
+    }
+    return res;
+}
+
+/* Returns the key shared by the position and its mirror image. */
+static uint64_t canonical_key(uint64_t white, uint64_t mask)
+{
+    uint64_t key = make_key(white, mask);
+    return min(key, mirror_key(key));
+}
+
+/* Returns a new, empty sorter with run files called base.N. */
+static db_sorter *new_sorter(const char *base)
+{
+    db_sorter *s;
+
+    if ((s = calloc(1, sizeof(db_sorter))) == NULL ||
+        (s->buf = malloc(DB_CHUNK * sizeof(db_record))) == NULL)
+        abort();
+    snprintf(s->base, sizeof(s->base), "%s", base);
+    return s;
+}
+
+static int compare_records(const void *a, const void *b)
+{
+    const db_record *x = a, *y = b;
+
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return (x->data > y->data) - (x->data < y->data);
+}
+
+/* Returns the name of run n of s. */
+static const char *run_name(db_sorter *s, int n)
+{
+    static char name[FILENAME_MAX + 48];
+
+    snprintf(name, sizeof(name), "%s.%d", s->base, n);
+    return name;
+}
+
+/* Sorts the buffer of s and writes it as the next run. Returns 0 on success,
+ * -1 otherwise. */
+static int flush_run(db_sorter *s)
+{
+    FILE *f;
+
+    if (s->runs == DB_MAX_RUNS) {
+        printf("Too many run files, increase DB_CHUNK.\n");
+        return -1;
+    }
+    qsort(s->buf, s->used, sizeof(db_record), compare_records);
+    if ((f = fopen(run_name(s, s->runs), "wb")) == NULL ||
+        fwrite(s->buf, sizeof(db_record), s->used, f) != s->used) {
+        printf("Can't write run file %s.\n", run_name(s, s->runs));
+        if (f != NULL)
+            fclose(f);
+        return -1;
+    }
+    fclose(f);
+    s->runs += 1;
+    s->used  = 0;
+    return 0;
+}
+
+/* Adds a record to s. Returns 0 on success, -1 otherwise. */
+static int sorter_add(db_sorter *s, uint64_t key, uint64_t data)
+{
+    if (s->used == DB_CHUNK && flush_run(s) < 0) {
+        return -1;
+    }
+    s->buf[s->used].key  = key;
+    s->buf[s->used].data = data;
+    s->used += 1;
+    return 0;
+}
+
+/* Stops adding records and prepares reading them in order. If they all fit
+ * into memory, no file is touched at all. Returns 0 on success, -1
+ * otherwise. */
+static int sorter_start(db_sorter *s)
+{
+    int i;
+
+    if (s->runs == 0) {
+        qsort(s->buf, s->used, sizeof(db_record), compare_records);
+        s->pos = 0;
+        return 0;
+    }
+    if (s->used > 0 && flush_run(s) < 0) {
+        return -1;
+    }
+    for (i = 0; i < s->runs; i++) {
+        if ((s->files[i] = fopen(run_name(s, i), "rb")) == NULL) {
+            printf("Can't read run file %s.\n", run_name(s, i));
+            return -1;
+        }
+        s->live[i] = fread(&s->heads[i], sizeof(db_record), 1,
+                           s->files[i]) == 1;
+    }
+    return 0;
+}
+
+/* Reads the next record in order into rec. Returns 1 if there was one, 0
+ * otherwise. */
+static int sorter_next(db_sorter *s, db_record *rec)
+{
+    int i, best = -1;
+
+    if (s->runs == 0) {
+        if (s->pos == s->used)
+            return 0;
+        *rec = s->buf[s->pos++];
+        return 1;
+    }
+    for (i = 0; i < s->runs; i++) {
+        if (s->live[i] && (best < 0 ||
+            compare_records(&s->heads[i], &s->heads[best]) < 0)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return 0;
+    }
+    *rec = s->heads[best];
+    s->live[best] = fread(&s->heads[best], sizeof(db_record), 1,
+                          s->files[best]) == 1;
+    return 1;
+}
+
+/* Closes and removes all run files of s and frees it. */
+static void free_sorter(db_sorter *s)
+{
+    int i;
+
+    for (i = 0; i < s->runs; i++) {
+        if (s->files[i] != NULL)
+            fclose(s->files[i]);
+        remove(run_name(s, i));
+    }
+    free(s->buf);
+    free(s);
+}
+
+/* Returns the name of a temporary file of ply for database file. */
+static const char *ply_name(const char *file, unsigned int ply,
+                            const char *kind)
+{
+    static char name[FILENAME_MAX + 32];
+
+    snprintf(name, sizeof(name), "%s.%u.%s", file, ply, kind);
+    return name;
+}
+
+/* Returns the stones of the player to move at ply. */
+static inline uint64_t own_stones(unsigned int ply, uint64_t white,
+                                  uint64_t mask)
+{
+    return (ply & 1) == WHITE ? white : white ^ mask;
+}
+
+/* Writes the positions following those of ply into the file of the next ply.
+ * Returns their number or -1 on errors. */
+static long long next_ply(const char *file, unsigned int ply)
+{
+    FILE *in, *out;
+    db_sorter *s;
+    db_record rec;
+    uint64_t key, white, mask, own, bit, last = 0;
+    unsigned int x;
+    long long n = 0;
+    int res = 0;
+
+    if ((in = fopen(ply_name(file, ply, "keys"), "rb")) == NULL) {
+        return -1;
+    }
+    s = new_sorter(ply_name(file, ply + 1, "run"));
+    while (res == 0 && fread(&key, sizeof(key), 1, in) == 1) {
+        split_key(key, &white, &mask);
+        own = own_stones(ply, white, mask);
+        for (x = 0; res == 0 && x < masks.x; x++) {
+            bit = (mask + masks.bottom) &
+                  (masks.column << (x * masks.col_len));
+            if ((bit >> (x * masks.col_len)) >> masks.y) {
+                continue; /* column full */
+            }
+            if (bitmap_has_won(own | bit, masks.y)) {
+                continue; /* game over */
+            }
+            res = sorter_add(s, canonical_key(
+                    (ply & 1) == WHITE ? white | bit : white, mask | bit), 0);
+        }
+    }
+    fclose(in);
+
+    if (res == 0 && sorter_start(s) == 0 &&
+        (out = fopen(ply_name(file, ply + 1, "keys"), "wb")) != NULL) {
+        while (sorter_next(s, &rec)) {
+            if (n > 0 && rec.key == last) {
+                continue;
+            }
+            fwrite(&rec.key, sizeof(rec.key), 1, out);
+            last = rec.key;
+            n++;
+        }
+        if (fclose(out) != 0)
+            n = -1;
+    } else {
+        n = -1;
+    }
+    free_sorter(s);
+    return n;
+}
+
+/* Computes the values of all positions of ply from those of the next one and
+ * writes them into the values file of ply. Returns 0 on success, -1
+ * otherwise. */
+static int back_up(const char *file, unsigned int ply, int last_ply)
+{
+    FILE *in, *keys = NULL, *values = NULL, *out;
+    db_sorter *children, *results;
+    db_record rec;
+    uint64_t key, white, mask, own, bit, index = 0, child = 0;
+    uint64_t count;
+    int8_t value = 0, best = UNKNOWN;
+    unsigned int x;
+    int moves, res = 0, found = 0;
+
+    if ((in = fopen(ply_name(file, ply, "keys"), "rb")) == NULL) {
+        return -1;
+    }
+    children = new_sorter(ply_name(file, ply, "children"));
+    results  = new_sorter(ply_name(file, ply, "results"));
+
+    /* Decide what can be decided right away, queue all other children. */
+    for (index = 0; res == 0 && fread(&key, sizeof(key), 1, in) == 1;
+         index++) {
+        split_key(key, &white, &mask);
+        own   = own_stones(ply, white, mask);
+        moves = 0;
+        for (x = 0; res == 0 && x < masks.x; x++) {
+            bit = (mask + masks.bottom) &
+                  (masks.column << (x * masks.col_len));
+            if ((bit >> (x * masks.col_len)) >> masks.y) {
+                continue; /* column full */
+            }
+            moves += 1;
+            if (bitmap_has_won(own | bit, masks.y)) {
+                res = sorter_add(results, index, WIN - LOSE);
+                break;
+            }
+            res = sorter_add(children, canonical_key(
+                    (ply & 1) == WHITE ? white | bit : white, mask | bit),
+                    index);
+        }
+        if (res == 0 && moves == 0) {
+            res = sorter_add(results, index, DRAW - LOSE);
+        }
+    }
+    fclose(in);
+    count = index;
+
+    /* Look up the children in the next ply, both are sorted by key. */
+    if (res == 0 && sorter_start(children) < 0) {
+        res = -1;
+    }
+    if (res == 0 && !last_ply &&
+        ((keys   = fopen(ply_name(file, ply + 1, "keys"), "rb")) == NULL ||
+         (values = fopen(ply_name(file, ply + 1, "values"), "rb")) == NULL)) {
+        res = -1;
+    }
+    while (res == 0 && sorter_next(children, &rec)) {
+        while (!found || child < rec.key) {
+            if (keys == NULL ||
+                fread(&child, sizeof(child), 1, keys) != 1 ||
+                fread(&value, sizeof(value), 1, values) != 1) {
+                printf("Position %llx missing in ply %u.\n",
+                       (unsigned long long) rec.key, ply + 1);
+                res = -1;
+                break;
+            }
+            found = 1;
+        }
+        if (res == 0 && child != rec.key) {
+            printf("Position %llx missing in ply %u.\n",
+                   (unsigned long long) rec.key, ply + 1);
+            res = -1;
+        }
+        if (res == 0) {
+            res = sorter_add(results, rec.data, -value - LOSE);
+        }
+    }
+    if (keys != NULL)
+        fclose(keys);
+    if (values != NULL)
+        fclose(values);
+
+    /* The best result of each position is its value. */
+    if (res == 0 && sorter_start(results) == 0 &&
+        (out = fopen(ply_name(file, ply, "values"), "wb")) != NULL) {
+        index = 0;
+        found = 0;
+        while (sorter_next(results, &rec)) {
+            if (found && rec.key != index) {
+                fwrite(&best, sizeof(best), 1, out);
+                index += 1;
+                found = 0;
+            }
+            if (rec.key != index) {
+                res = -1;
+                break;
+            }
+            value = (int8_t) rec.data + LOSE;
+            best  = found ? max(best, value) : value;
+            found = 1;
+        }
+        if (found) {
+            fwrite(&best, sizeof(best), 1, out);
+            index += 1;
+        }
+        if (fclose(out) != 0 || index != count)
+            res = -1;
+    } else {
+        res = -1;
+    }
+    free_sorter(children);
+    free_sorter(results);
+    return res;
+}
+
+/* Copies the temporary files of all plies into the database file. Returns 0 on
+ * success, -1 otherwise. */
+static int write_db(const char *file, board_size *size, unsigned int plies,
+                    uint64_t *counts)
+{
+    FILE *out, *in;
+    uint32_t header[4];
+    uint64_t key, i;
+    uint8_t packed;
+    int8_t value;
+    unsigned int ply;
+    int res = 0;
+
+    if ((out = fopen(file, "wb")) == NULL) {
+        printf("Can't write to %s.\n", file);
+        return -1;
+    }
+    header[0] = DB_VERSION;
+    header[1] = size->x;
+    header[2] = size->y;
+    header[3] = plies;
+    fwrite(DB_MAGIC, 4, 1, out);
+    fwrite(header, sizeof(header), 1, out);
+    fwrite(counts, sizeof(uint64_t), plies, out);
+
+    for (ply = 0; res == 0 && ply < plies; ply++) {
+        if ((in = fopen(ply_name(file, ply, "keys"), "rb")) == NULL) {
+            res = -1;
+            break;
+        }
+        while (fread(&key, sizeof(key), 1, in) == 1) {
+            fwrite(&key, sizeof(key), 1, out);
+        }
+        fclose(in);
+
+        if ((in = fopen(ply_name(file, ply, "values"), "rb")) == NULL) {
+            res = -1;
+            break;
+        }
+        packed = 0;
+        for (i = 0; i < counts[ply]; i++) {
+            if (fread(&value, sizeof(value), 1, in) != 1) {
+                res = -1;
+                break;
+            }
+            packed |= ((value - LOSE) / 2) << (2 * (i & 3));
+            if ((i & 3) == 3) {
+                fwrite(&packed, 1, 1, out);
+                packed = 0;
+            }
+        }
+        if (i & 3)
+            fwrite(&packed, 1, 1, out);
+        fclose(in);
+    }
+    if (fclose(out) != 0)
+        res = -1;
+    return res;
+}
+
+/* Enumerates all positions of size, computes their values and writes them to
+ * file. Temporary files are called file.* and removed afterwards. Returns 0
+ * on success, -1 otherwise. */
+int build_db(board_size *size, const char *file)
+{
+    FILE *f;
+    uint64_t counts[DB_MAX_PLY], key, total = 0;
+    unsigned int plies, ply;
+    long long n;
+    double start = get_time();
+    int res = 0;
+
+    if (size->x * (size->y + 1) > 64 || size->x > MAX_COLS ||
+        size->x * size->y >= DB_MAX_PLY) {
+        printf("Board too large for a database.\n");
+        return -1;
+    }
+    init_masks(size);
+
+    /* Enumerate. */
+    key = make_key(0, 0);
+    if ((f = fopen(ply_name(file, 0, "keys"), "wb")) == NULL) {
+        printf("Can't write to %s.\n", ply_name(file, 0, "keys"));
+        return -1;
+    }
+    fwrite(&key, sizeof(key), 1, f);
+    fclose(f);
+    counts[0] = 1;
+    for (plies = 1; plies <= size->x * size->y; plies++) {
+        if ((n = next_ply(file, plies - 1)) < 0) {
+            res = -1;
+            break;
+        }
+        if (n == 0) {
+            remove(ply_name(file, plies, "keys"));
+            break;
+        }
+        counts[plies] = n;
+        total += n;
+        printf("Ply %u: %lld positions (%.1fs).\n", plies, n,
+               get_time() - start);
+    }
+
+    /* Back up values. */
+    for (ply = plies; res == 0 && ply-- > 0;) {
+        if (back_up(file, ply, ply == plies - 1) < 0) {
+            printf("Backing up ply %u failed.\n", ply);
+            res = -1;
+        }
+    }
+
+    if (res == 0) {
+        res = write_db(file, size, plies, counts);
+    }
+    for (ply = 0; ply < plies; ply++) {
+        remove(ply_name(file, ply, "keys"));
+        remove(ply_name(file, ply, "values"));
+    }
+    if (res == 0) {
+        printf("Wrote %llu positions in %u plies to %s (%.1fs).\n",
+               (unsigned long long) total + 1, plies, file,
+               get_time() - start);
+    }
+    return res;
+}
+
+/* Opens a database written by build_db(). Returns NULL on errors. */
+solution_db *open_db(const char *file)
+{
+    solution_db *db;
+    char magic[4];
+    uint32_t header[4];
+    unsigned int ply;
+    long pos;
+
+    if ((db = calloc(1, sizeof(solution_db))) == NULL)
+        abort();
+    if ((db->f = fopen(file, "rb")) == NULL) {
+        printf("Can't open database %s.\n", file);
+        free(db);
+        return NULL;
+    }
+    if (fread(magic, 4, 1, db->f) != 1 || memcmp(magic, DB_MAGIC, 4) != 0 ||
+        fread(header, sizeof(header), 1, db->f) != 1 ||
+        header[0] != DB_VERSION || header[3] > DB_MAX_PLY ||
+        fread(db->counts, sizeof(uint64_t), header[3], db->f) != header[3]) {
+        printf("%s is no database of this version.\n", file);
+        close_db(db);
+        return NULL;
+    }
+    db->size.x = header[1];
+    db->size.y = header[2];
+    db->plies  = header[3];
+
+    pos = 4 + sizeof(header) + db->plies * sizeof(uint64_t);
+    for (ply = 0; ply < db->plies; ply++) {
+        db->keys[ply]   = pos;
+        db->values[ply] = pos + db->counts[ply] * sizeof(uint64_t);
+        pos = db->values[ply] + (db->counts[ply] + 3) / 4;
+    }
+    return db;
+}
+
+/* Returns the value of board for the player to move or UNKNOWN if db doesn't
+ * know it, e.g. because the game is already over. */
+board_state db_lookup(solution_db *db, board *board)
+{
+    uint64_t key, mid_key, lo, hi, mid;
+    uint8_t packed;
+    unsigned int ply = board->turn;
+
+    if (board->size->x != db->size.x || board->size->y != db->size.y ||
+        ply >= db->plies) {
+        return UNKNOWN;
+    }
+    init_masks(&db->size);
+    key = canonical_key(board->bitmap[WHITE],
+                        board->bitmap[WHITE] | board->bitmap[BLACK]);
+
+    lo = 0;
+    hi = db->counts[ply];
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (fseek(db->f, db->keys[ply] + mid * sizeof(uint64_t),
+                  SEEK_SET) != 0 ||
+            fread(&mid_key, sizeof(mid_key), 1, db->f) != 1) {
+            return UNKNOWN;
+        }
+        if (mid_key == key) {
+            if (fseek(db->f, db->values[ply] + mid / 4, SEEK_SET) != 0 ||
+                fread(&packed, 1, 1, db->f) != 1) {
+                return UNKNOWN;
+            }
+            return ((packed >> (2 * (mid & 3))) & 3) * 2 + LOSE;
+        }
+        if (mid_key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return UNKNOWN;
+}
+
+/* Closes db. */
+void close_db(solution_db *db)
+{
+    if (db->f != NULL)
+        fclose(db->f);
+    free(db);
+}
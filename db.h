@@ -0,0 +1,35 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_DB_H
+#define YONMOKUNARABE_DB_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "ai.h"
+#include "board.h"
+
+#define DB_MAGIC "YMKD"
+#define DB_VERSION 1
+#define DB_CHUNK (1<<20)  /* Records sorted in memory at once (16 bytes each).
+                             Everything beyond that goes through run files. */
+#define DB_MAX_RUNS 1024  /* Run files merged at once. */
+#define DB_MAX_PLY 64
+
+/* An open database. Lookups read the file, only the index is in memory. */
+typedef struct solution_db {
+    FILE *f;
+    board_size size;
+    unsigned int plies;                /* plies stored, 0 to plies-1 */
+    uint64_t counts[DB_MAX_PLY];       /* positions of each ply */
+    long keys[DB_MAX_PLY];             /* offset of the keys of each ply */
+    long values[DB_MAX_PLY];           /* offset of the values of each ply */
+} solution_db;
+
+int build_db(board_size *size, const char *file);
+solution_db *open_db(const char *file);
+board_state db_lookup(solution_db *db, board *board);
+void close_db(solution_db *db);
+
+#endif /* end of include guard: YONMOKUNARABE_DB_H */
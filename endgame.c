@@ -0,0 +1,123 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Solver for the last few empty fields. alpha_beta() hands boards over to it
+ * once at most params.endgame_empty fields are left. It works on the two
+ * bitmaps alone: no hash, no move scores, no hash keys to update. Moves that
+ * allow an immediate loss are never tried and forced moves are played
+ * without looking at anything else.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "endgame.h"
+#include "eval.h"
+
+/* Counters of the calling thread. */
+static THREAD_LOCAL unsigned long endgame_counter = 0; /* How many nodes were
+                                                          searched? */
+static THREAD_LOCAL unsigned long handoff_counter = 0; /* How many boards were
+                                                          handed over? */
+
+/* Counters handed over by merge_endgame_stats(), not printed yet. */
+static unsigned long merged_endgame = 0, merged_handoff = 0;
+static pthread_mutex_t merge_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Prepares masks for boards of the given size. */
+void init_endgame(board_size *size)
+{
+    init_masks(size);
+    endgame_counter = handoff_counter = 0;
+    merged_endgame = merged_handoff = 0;
+}
+
+/* Searches the board given by the stones of the player to move and all stones.
+ * Returns the same values as alpha_beta(). */
+static board_state search(uint64_t own, uint64_t mask,
+                          board_state alpha, board_state beta)
+{
+    uint64_t possible, threats, opp, m;
+    board_state res = LOSE;
+    board_state temp;
+    unsigned int i;
+
+    endgame_counter += 1;
+
+    possible = (mask + masks.bottom) & masks.board;
+    if (possible == 0) {
+        return DRAW;
+    }
+    if (bitmap_winning_fields(own, masks.y) & masks.board & possible) {
+        return WIN;
+    }
+
+    opp     = own ^ mask;
+    threats = bitmap_winning_fields(opp, masks.y) & masks.board;
+    if (threats & possible) {
+        possible &= threats;
+        if (possible & (possible - 1)) {
+            return LOSE; /* More than 1 threat. */
+        }
+    }
+#if USE_DEAD_LINES == 1
+    /* Nobody can complete a line any more. */
+    if (!bitmap_has_won(masks.board & ~opp, masks.y) &&
+        !bitmap_has_won(masks.board & ~own, masks.y)) {
+        return DRAW;
+    }
+#endif
+    /* Don't play right below a field the opponent needs. */
+    possible &= ~(threats >> 1);
+
+    for (i = 0; possible != 0 && i < masks.x; i++) {
+        if ((m = possible & masks.cols[i]) == 0) {
+            continue;
+        }
+        possible ^= m;
+        temp  = -search(opp, mask | m, -beta, -alpha);
+        res   = max(res, temp);
+        alpha = max(res, alpha);
+        if (alpha >= beta) { /* cut-off */
+            /* Untried moves may hide a WIN, see alpha_beta(). */
+            if (possible != 0 && res == DRAW) {
+                res = MAYBE_WIN;
+            }
+            break;
+        }
+    }
+    return res;
+}
+
+/* Returns the value of the board for the player to move, like alpha_beta(). */
+board_state endgame(search_board *sb, board_state alpha, board_state beta)
+{
+    handoff_counter += 1;
+    return search(sb->bitmap[sb->player], sb->mask, alpha, beta);
+}
+
+/* Hands the counters of the calling thread over to print_endgame_stats().
+ * Worker threads call this before they end. */
+void merge_endgame_stats()
+{
+    pthread_mutex_lock(&merge_lock);
+    merged_endgame += endgame_counter;
+    merged_handoff += handoff_counter;
+    pthread_mutex_unlock(&merge_lock);
+    endgame_counter = handoff_counter = 0;
+}
+
+/* Prints endgame stats, including those handed over by other threads. */
+void print_endgame_stats()
+{
+    pthread_mutex_lock(&merge_lock);
+    endgame_counter += merged_endgame;
+    handoff_counter += merged_handoff;
+    merged_endgame = merged_handoff = 0;
+    pthread_mutex_unlock(&merge_lock);
+
+    printf("Endgame boards: %lu, nodes: %lu.\n",
+           handoff_counter, endgame_counter);
+}
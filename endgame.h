@@ -0,0 +1,16 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_ENDGAME_H
+#define YONMOKUNARABE_ENDGAME_H
+
+#include "ai.h"
+#include "board.h"
+
+void init_endgame(board_size *size);
+board_state endgame(search_board *sb, board_state alpha, board_state beta);
+void merge_endgame_stats();
+void print_endgame_stats();
+
+#endif /* end of include guard: YONMOKUNARABE_ENDGAME_H */
@@ -0,0 +1,217 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Static evaluation via Allis' odd/even rules.
+ *
+ * If every column has an even number of empty fields, the player not to move
+ * can always answer in the column the other one just played in ("follow-up").
+ * The player to move then ends up with exactly the empty fields in rows of
+ * the same parity as the board height (the leader rows), the follower with
+ * all the others. So if the leader can't complete a line with those, the
+ * leader can't win (claimeven). If the follower additionally completes one,
+ * the follower wins.
+ *
+ * If exactly one column has an odd number of empty fields, the player to move
+ * can play there and become the follower instead (column zugzwang).
+ *
+ * Threat parity (odd and even threats) is left out on purpose. Allis' threat
+ * rules only hold together with his checks for conflicts between the
+ * solutions of all threats. Alone, they misjudge boards, and a wrong static
+ * value would spread through the hash.
+ *
+ * Independent of that, a player can only still win if some line holds no
+ * stone of the opponent. If there is no such line for either player, the
+ * board is a draw however it is played out.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "eval.h"
+
+static uint64_t leader_rows   = 0; /* fields of the player moving first */
+static uint64_t follower_rows = 0; /* fields of the player following up */
+
+/* Counters of the calling thread. */
+static THREAD_LOCAL unsigned long eval_counter    = 0; /* How often did we
+                                                          evaluate? */
+static THREAD_LOCAL unsigned long decided_counter = 0; /* How often was that a
+                                                          result? */
+static THREAD_LOCAL unsigned long bound_counter   = 0; /* How often was that a
+                                                          bound? */
+static THREAD_LOCAL unsigned long dead_counter    = 0; /* How often could
+                                                          nobody win? */
+static THREAD_LOCAL unsigned long one_counter     = 0; /* How often could only
+                                                          one win? */
+
+/* Counters handed over by merge_eval_stats(), not printed yet. */
+static unsigned long merged_eval = 0, merged_decided = 0, merged_bound = 0;
+static unsigned long merged_dead = 0, merged_one = 0;
+static pthread_mutex_t merge_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Prepares masks for boards of the given size. */
+void init_eval(board_size *size)
+{
+    unsigned int y;
+
+    init_masks(size);
+    leader_rows = 0;
+    for (y = size->y & 1; y < size->y; y += 2) {
+        leader_rows |= masks.bottom << y;
+    }
+    follower_rows = masks.board & ~leader_rows;
+    eval_counter = decided_counter = bound_counter = 0;
+    dead_counter = one_counter = 0;
+    merged_eval = merged_decided = merged_bound = 0;
+    merged_dead = merged_one = 0;
+}
+
+/* Returns the number of lines player can still complete on sb. */
+unsigned int open_lines(search_board *sb, players player)
+{
+    uint64_t pos, x;
+    unsigned int d[4], i, n = 0;
+
+    pos  = masks.board & ~sb->bitmap[player^1];
+    d[0] = 1;         /* | */
+    d[1] = sb->y + 1; /* - */
+    d[2] = sb->y + 2; /* / */
+    d[3] = sb->y;     /* \ */
+    for (i = 0; i < 4; i++) {
+        /* Each open line leaves its lowest field in x. */
+        x  = pos & (pos >> d[i]);
+        x &= x >> 2*d[i];
+        for (; x != 0; x &= x - 1) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/* Returns DRAW if neither player can complete a line any more, MAYBE_LOSE if
+ * only the opponent can, MAYBE_WIN if only the player to move can and UNKNOWN
+ * otherwise. */
+board_state line_eval(search_board *sb)
+{
+    players p = sb->player;
+    int own, opp;
+
+    own = bitmap_has_won(masks.board & ~sb->bitmap[p^1], sb->y);
+    opp = bitmap_has_won(masks.board & ~sb->bitmap[p], sb->y);
+    if (own && opp) {
+        return UNKNOWN;
+    }
+    if (!own && !opp) {
+        dead_counter += 1;
+        return DRAW;
+    }
+    one_counter += 1;
+    return own ? MAYBE_WIN : MAYBE_LOSE;
+}
+
+/* Returns the value of the board for the player to move if the odd/even rules
+ * decide it, a bound (MAYBE_WIN, MAYBE_LOSE) if they limit it or UNKNOWN. */
+board_state parity_eval(search_board *sb)
+{
+    uint64_t empty, odd;
+    players p = sb->player;
+
+    eval_counter += 1;
+    empty = masks.board & ~sb->mask;
+    /* The lowest empty field of a column with an odd number of them is in a
+     * follower row. */
+    odd = (sb->mask + masks.bottom) & follower_rows;
+
+    if (odd == 0) {
+        /* The opponent can follow up. */
+        if (bitmap_has_won(sb->bitmap[p] | (empty & leader_rows), sb->y)) {
+            return UNKNOWN;
+        }
+        if (bitmap_has_won(sb->bitmap[p^1] | (empty & follower_rows), sb->y)) {
+            decided_counter += 1;
+            return LOSE;
+        }
+        bound_counter += 1;
+        return MAYBE_LOSE;
+    }
+
+    if ((odd & (odd - 1)) == 0) {
+        /* Play in the only odd column, then follow up. */
+        empty ^= odd;
+        if (bitmap_has_won(sb->bitmap[p^1] | (empty & leader_rows), sb->y)) {
+            return UNKNOWN;
+        }
+        if (bitmap_has_won(sb->bitmap[p] | odd | (empty & follower_rows),
+                           sb->y)) {
+            decided_counter += 1;
+            return WIN;
+        }
+        bound_counter += 1;
+        return MAYBE_WIN;
+    }
+
+    return UNKNOWN;
+}
+
+/* Returns the value of the board for the player to move as far as the enabled
+ * evaluations tell: a result (WIN, DRAW, LOSE), a bound (MAYBE_WIN,
+ * MAYBE_LOSE) or UNKNOWN. */
+board_state static_eval(search_board *sb)
+{
+    board_state lines  = UNKNOWN;
+    board_state parity = UNKNOWN;
+
+#if USE_DEAD_LINES == 1
+    if ((lines = line_eval(sb)) == DRAW) {
+        return DRAW;
+    }
+#endif
+#if USE_PARITY == 1
+    parity = parity_eval(sb);
+#endif
+    if (lines == UNKNOWN || lines == parity || parity == WIN ||
+        parity == LOSE) {
+        return parity == UNKNOWN ? lines : parity;
+    }
+    if (parity == UNKNOWN) {
+        return lines;
+    }
+    /* Upper and lower bound meet. */
+    return DRAW;
+}
+
+/* Hands the counters of the calling thread over to print_eval_stats(). Worker
+ * threads call this before they end. */
+void merge_eval_stats()
+{
+    pthread_mutex_lock(&merge_lock);
+    merged_eval    += eval_counter;
+    merged_decided += decided_counter;
+    merged_bound   += bound_counter;
+    merged_dead    += dead_counter;
+    merged_one     += one_counter;
+    pthread_mutex_unlock(&merge_lock);
+    eval_counter = decided_counter = bound_counter = 0;
+    dead_counter = one_counter = 0;
+}
+
+/* Prints evaluation stats, including those handed over by other threads. */
+void print_eval_stats()
+{
+    pthread_mutex_lock(&merge_lock);
+    eval_counter    += merged_eval;
+    decided_counter += merged_decided;
+    bound_counter   += merged_bound;
+    dead_counter    += merged_dead;
+    one_counter     += merged_one;
+    merged_eval = merged_decided = merged_bound = 0;
+    merged_dead = merged_one = 0;
+    pthread_mutex_unlock(&merge_lock);
+
+    printf("Parity evaluations: %lu, decided: %lu, bounded: %lu.\n",
+           eval_counter, decided_counter, bound_counter);
+    printf("Dead boards: %lu, only one side can win: %lu.\n",
+           dead_counter, one_counter);
+}
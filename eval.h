@@ -0,0 +1,23 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_EVAL_H
+#define YONMOKUNARABE_EVAL_H
+
+#include "ai.h"
+#include "board.h"
+
+#define USE_PARITY 1 /* Use odd/even rules to decide boards without search? */
+#define USE_DEAD_LINES 1 /* Close boards nobody can win any more as draws? */
+#define USE_EVAL (USE_PARITY || USE_DEAD_LINES)
+
+void init_eval(board_size *size);
+board_state parity_eval(search_board *sb);
+unsigned int open_lines(search_board *sb, players player);
+board_state line_eval(search_board *sb);
+board_state static_eval(search_board *sb);
+void merge_eval_stats();
+void print_eval_stats();
+
+#endif /* end of include guard: YONMOKUNARABE_EVAL_H */
@@ -2,57 +2,147 @@
  * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
  */
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include "ai.h"
 #include "board.h"
+#include "common.h"
 #include "hash.h"
+#include "params.h"
 
-/* What, you need more than one hash? Pff. */
-static hash_node *hash[HASHSIZE];
+static hash_node *hash = NULL;
+static unsigned long hash_size = 0; /* Slots in the hash. */
 
-static unsigned long hash_counter = 0; /* How many slots of the hash are used? */
-static unsigned long col_counter  = 0; /* How many collisions happened? */
-static unsigned long miss_counter = 0; /* How many entries couldn't be found? */
+/* Boards from params.deep_hash_ply on are numerous and cheap to search again.
+ * They get a small table of their own, which always replaces, so they can't
+ * push the expensive boards near the root out of the main hash. */
+static hash_node *deep = NULL;
+static unsigned long deep_size = 0; /* Slots in the deep hash. */
 
-/* Return result from hash. */
-board_state get_hash(board *board)
+static uint32_t generation = 0; /* Current generation, bumped on every reset. */
+static int keep = 0;            /* Keep entries for boards of the same size? */
+static board_size last_size;    /* Size of the boards currently in the hash. */
+
+/* While several threads search at once, every access locks the stripe of its
+ * slot. The counters below belong to the calling thread. */
+static int shared = 0;
+static int locks_ready = 0;
+static pthread_mutex_t locks[HASH_STRIPES];
+
+static THREAD_LOCAL unsigned long hash_counter = 0; /* How many slots of the
+                                                       hash are used? */
+static THREAD_LOCAL unsigned long col_counter  = 0; /* How many collisions
+                                                       happened? */
+static THREAD_LOCAL unsigned long upd_counter  = 0; /* How many slots were
+                                                       re-stored with the same
+                                                       board? */
+static THREAD_LOCAL unsigned long miss_counter = 0; /* How many entries
+                                                       couldn't be found? */
+static THREAD_LOCAL unsigned long deep_counter = 0; /* Same for the deep
+                                                       hash. */
+static THREAD_LOCAL unsigned long deep_col_counter  = 0;
+static THREAD_LOCAL unsigned long deep_miss_counter = 0;
+
+/* Counters handed over by merge_hash_stats(), not collected yet. */
+static unsigned long merged_hash = 0, merged_col = 0, merged_upd = 0;
+static unsigned long merged_miss = 0, merged_deep = 0;
+static unsigned long merged_deep_col = 0, merged_deep_miss = 0;
+static pthread_mutex_t merge_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Adds the counters handed over by other threads to those of the calling
+ * thread. */
+static void collect_stats()
 {
-	hash_node *node;
-    uint64_t board_hash;
-	
-#if HASH_CUT_OFF > -1
-	/*Skip hashs if recalculation would be faster.*/
-	if (board->turn > HASH_CUT_OFF) {
-		return UNKNOWN;
+	pthread_mutex_lock(&merge_lock);
+	hash_counter      += merged_hash;
+	col_counter       += merged_col;
+	upd_counter       += merged_upd;
+	miss_counter      += merged_miss;
+	deep_counter      += merged_deep;
+	deep_col_counter  += merged_deep_col;
+	deep_miss_counter += merged_deep_miss;
+	merged_hash = merged_col = merged_upd = merged_miss = 0;
+	merged_deep = merged_deep_col = merged_deep_miss = 0;
+	pthread_mutex_unlock(&merge_lock);
+}
+
+#if HASH_REPLACE == 0
+/* Frees a list of collided entries. */
+static void free_list(hash_node *node)
+{
+	hash_node *next;
+
+	while (node != NULL) {
+		next = node->next;
+		free(node);
+		node = next;
 	}
+}
 #endif
 
-#if USE_SYMMETRY == 1
-#if SYMMETRY_CUT_OFF > -1
-	if (board->turn < SYMMETRY_CUT_OFF) {
-#endif
-		if (board->hash > board->sym_hash) {
-			board_hash = board->hash;
-		} else {
-			board_hash = board->sym_hash;
-		}
-#if SYMMETRY_CUT_OFF > -1
-	} else {
-        board_hash = board->hash;
-    }
-#endif
-#else
-	board_hash = board->hash;
-#endif
+/* Does board belong into the deep hash? */
+static inline int is_deep(search_board *board)
+{
+	return params.deep_hash_ply > -1 && board->turn >= params.deep_hash_ply;
+}
+
+/* Returns the slot for board or NULL if it shouldn't be hashed. */
+static hash_node *find_slot(search_board *board)
+{
+	uint64_t board_hash = board->hash;
+
+	/* Skip hashs if recalculation would be faster. */
+	if (params.hash_cut_off > -1 && board->turn > params.hash_cut_off) {
+		return NULL;
+	}
 
+	if (params.use_symmetry &&
+		(params.symmetry_cut_off < 0 ||
+		 board->turn < params.symmetry_cut_off) &&
+		board->sym_hash > board_hash) {
+		board_hash = board->sym_hash;
+	}
+
+	/* Map the upper half onto the table without a division. */
+	if (is_deep(board)) {
+		return &deep[((board_hash >> 32) * deep_size) >> 32];
+	}
+	return &hash[((board_hash >> 32) * hash_size) >> 32];
+}
+
+/* Returns the lock of the stripe node belongs to. */
+static inline pthread_mutex_t *stripe(hash_node *node)
+{
+	return &locks[((uintptr_t) node / sizeof(hash_node)) & (HASH_STRIPES-1)];
+}
+
+/* Looks board up in its slot node, see get_hash(). */
+static inline board_state read_node(hash_node *node, search_board *board,
+									int *move)
+{
+	if (is_deep(board)) {
+		if (node->gen == generation &&
+			node->bitmap[WHITE] == board->bitmap[WHITE] &&
+			node->bitmap[BLACK] == board->bitmap[BLACK]) {
+			*move = node->move;
+			return node->res;
+		}
+		deep_miss_counter += 1;
+		return UNKNOWN;
+	}
+	if (node->gen != generation) { /* stale or empty */
+		miss_counter += 1;
+		return UNKNOWN;
+	}
 #if HASH_REPLACE == 0
 	/* Collisions are saved in a linked list. */
-	node = hash[board_hash % HASHSIZE];
 	while (node != NULL) {
 		if (node->bitmap[WHITE] == board->bitmap[WHITE] &&
 			node->bitmap[BLACK] == board->bitmap[BLACK]) { /* hash found */
+			*move = node->move;
 			return node->res;
 		} else { /* check other nodes */
 			node = node->next;
@@ -60,12 +150,10 @@ board_state get_hash(board *board)
 	}
 #else
 	/* Collisions replace the old entry. */
-	node = hash[board_hash % HASHSIZE];
-	if (node != NULL) {
-		if (node->bitmap[WHITE] == board->bitmap[WHITE] &&
-			node->bitmap[BLACK] == board->bitmap[BLACK]) { /* hash found */
-			return node->res;
-		}
+	if (node->bitmap[WHITE] == board->bitmap[WHITE] &&
+		node->bitmap[BLACK] == board->bitmap[BLACK]) { /* hash found */
+		*move = node->move;
+		return node->res;
 	}
 #endif
 	/* not in the hash */
@@ -73,114 +161,323 @@ board_state get_hash(board *board)
     return UNKNOWN;
 }
 
-/* Set hash for board. Returns same result again. */
-board_state set_hash(board *board, board_state res)
+/* Return result from hash. Sets move to the best move stored with it or -1. */
+board_state get_hash(search_board *board, int *move)
 {
-	hash_node *node, *new;
-	uint64_t board_hash = 0;
+	hash_node *node;
+	board_state res;
 
-#if HASH_CUT_OFF > -1
-	/* Skip hashs if recalculation would be faster. */
-	if (board->turn > HASH_CUT_OFF) {
-		return res;
+	*move = -1;
+	if ((node = find_slot(board)) == NULL) {
+		return UNKNOWN;
 	}
-#endif
+	if (!shared) {
+		return read_node(node, board, move);
+	}
+	pthread_mutex_lock(stripe(node));
+	res = read_node(node, board, move);
+	pthread_mutex_unlock(stripe(node));
+	return res;
+}
 
-#if USE_SYMMETRY == 1
-#if SYMMETRY_CUT_OFF > -1
-	if (board->turn < SYMMETRY_CUT_OFF) {
+/* Stores res and move for board in node. */
+static inline void fill_node(hash_node *node, search_board *board,
+							 board_state res, int move)
+{
+	node->bitmap[0] = board->bitmap[0];
+	node->bitmap[1] = board->bitmap[1];
+	node->res       = res;
+	node->move      = move;
+	node->gen       = generation;
+}
+
+/* Stores res and move for board in its slot node, see set_hash(). */
+static inline void write_node(hash_node *node, search_board *board,
+							  board_state res, int move)
+{
+#if HASH_REPLACE == 0
+	hash_node *new;
 #endif
-		if (board->hash > board->sym_hash) {
-			board_hash = board->hash;
-		} else {
-			board_hash = board->sym_hash;
+
+	if (is_deep(board)) {
+		/* The deep hash always replaces. */
+		if (node->gen != generation) {
+			deep_counter += 1;
+		} else if (node->bitmap[WHITE] != board->bitmap[WHITE] ||
+				   node->bitmap[BLACK] != board->bitmap[BLACK]) {
+			deep_col_counter += 1;
 		}
-#if SYMMETRY_CUT_OFF > -1
-	} else {
-        board_hash = board->hash;
+		fill_node(node, board, res, move);
+		return;
 	}
-#endif
-#else
-	board_hash = board->hash;
-#endif
-
 #if HASH_REPLACE == 0
-	/* Collisions are saved in a linked list. */
-
-    if ((new = malloc(sizeof(hash_node))) == NULL)
-		abort();
-	new->bitmap[0] = board->bitmap[0];
-	new->bitmap[1] = board->bitmap[1];
-	new->res       = res;
-	new->next      = NULL;
-
-	node = hash[board_hash % HASHSIZE];
-	if (node != NULL) { /* insert node into list */
-		col_counter += 1;
-		new->next = node;
-	} else {
+	/* Collisions are saved in a linked list. The slot itself holds the newest
+	 * entry, older ones are moved into the list. */
+	if (node->gen != generation) { /* stale or empty, drop the old list */
 		hash_counter += 1;
+		free_list(node->next);
+		node->next = NULL;
+	} else { /* insert node into list */
+		col_counter += 1;
+		if ((new = malloc(sizeof(hash_node))) == NULL)
+			abort();
+		*new = *node;
+		node->next = new;
 	}
-	hash[board_hash % HASHSIZE] = new;
 #else
 	/* Collisions replace the old entry. */
-	node = hash[board_hash % HASHSIZE];
-	if (node != NULL) { /* replace old node */
-		col_counter += 1;
-		node->bitmap[0] = board->bitmap[0];
-		node->bitmap[1] = board->bitmap[1];
-		node->res       = res;
-	} else {
+	if (node->gen != generation) { /* stale or empty */
 		hash_counter += 1;
-		if ((new = malloc(sizeof(hash_node))) == NULL)
-			abort();
-		new->bitmap[0] = board->bitmap[0];
-		new->bitmap[1] = board->bitmap[1];
-		new->res       = res;
-		hash[board_hash % HASHSIZE] = new;
+	} else if (node->bitmap[WHITE] == board->bitmap[WHITE] &&
+			   node->bitmap[BLACK] == board->bitmap[BLACK]) {
+		upd_counter += 1;
+	} else { /* replace old node */
+		col_counter += 1;
 	}
 #endif
+	fill_node(node, board, res, move);
+}
+
+/* Set hash for board, along with its best move (or -1). Returns same result
+ * again. */
+board_state set_hash(search_board *board, board_state res, int move)
+{
+	hash_node *node;
+
+	if ((node = find_slot(board)) == NULL) {
+		return res;
+	}
+	if (!shared) {
+		write_node(node, board, res, move);
+	} else {
+		pthread_mutex_lock(stripe(node));
+		write_node(node, board, res, move);
+		pthread_mutex_unlock(stripe(node));
+	}
+
 	/* Return same result regardlass of hash. */
     return res;
 }
 
-/* Initializes hash. Also call this whenever the board size changes. */
-void init_hash()
+/* Empties hash. Also call this whenever the board size changes. This only
+ * starts a new generation, old entries are ignored from then on. With
+ * keep_hash() set, entries for boards of the same size are kept instead. */
+void init_hash(board_size *size)
+{
+	unsigned long i;
+
+	collect_stats();
+	if (keep && generation > 0 && hash_size == params.hash_size &&
+		deep_size == params.deep_hash_size &&
+		size->x == last_size.x && size->y == last_size.y) {
+		printf("Keeping hash (%lu entries)...\n", hash_counter);
+		col_counter = upd_counter = miss_counter = 0;
+		deep_col_counter = deep_miss_counter = 0;
+		return;
+	}
+
+	printf("Initializing hash (%lu bytes)...\n",
+		   (params.hash_size + params.deep_hash_size)*sizeof(hash_node));
+
+	last_size = *size;
+
+	if (hash_size != params.hash_size || deep_size != params.deep_hash_size) {
+		/* Resize. Fresh memory is zero, so generation 0 marks it empty. Both
+		 * tables share the generation, so both start over. */
+		for (i = 0; i < hash_size; i++) {
+#if HASH_REPLACE == 0
+			free_list(hash[i].next);
+#endif
+		}
+		free(hash);
+		free(deep);
+		hash_size = params.hash_size;
+		deep_size = params.deep_hash_size;
+		if ((hash = calloc(hash_size, sizeof(hash_node))) == NULL ||
+			(deep = calloc(deep_size, sizeof(hash_node))) == NULL)
+			abort();
+		generation = 0;
+	}
+	clear_hash();
+}
+
+/* Empties hash quietly, without looking at keep_hash() or the board size. */
+void clear_hash()
+{
+	unsigned long i;
+
+	collect_stats();
+	hash_counter = col_counter = upd_counter = miss_counter = 0;
+	deep_counter = deep_col_counter = deep_miss_counter = 0;
+	generation += 1;
+	if (generation == 0) {
+		/* Wrapped around, so old entries could look current again. This only
+		 * happens every 2^32 resets, so just clear everything. */
+		for (i = 0; i < hash_size; i++) {
+#if HASH_REPLACE == 0
+			free_list(hash[i].next);
+			hash[i].next = NULL;
+#endif
+			hash[i].gen = 0;
+		}
+		for (i = 0; i < deep_size; i++) {
+			deep[i].gen = 0;
+		}
+		generation = 1;
+	}
+}
+
+/* Lock entries while several threads use the hash? Only switch this while no
+ * search is running. */
+void share_hash(int on)
 {
 	int i;
+
+	if (on && !locks_ready) {
+		for (i = 0; i < HASH_STRIPES; i++) {
+			pthread_mutex_init(&locks[i], NULL);
+		}
+		locks_ready = 1;
+	}
+	shared = on;
+}
+
+/* Keep entries between searches of boards of the same size? */
+void keep_hash(int k)
+{
+	keep = k;
+}
+
+/* Writes a single entry of slot i to f. */
+static void write_entry(FILE *f, uint32_t i, hash_node *node)
+{
+	fwrite(&i, sizeof(i), 1, f);
+	fwrite(node->bitmap, sizeof(node->bitmap), 1, f);
+	fwrite(&node->res, sizeof(node->res), 1, f);
+	fwrite(&node->move, sizeof(node->move), 1, f);
+}
+
+/* Writes all current entries of the main hash to f as slot index and entry.
+ * The deep hash is cheap to fill again, so it isn't saved. Returns the number
+ * of entries written. */
+unsigned long save_hash(FILE *f)
+{
+#if HASH_REPLACE == 0
 	hash_node *node;
+#endif
+	uint32_t i;
+	unsigned long n = 0;
+
+	for (i = 0; i < hash_size; i++) {
+		if (hash[i].gen != generation) {
+			continue;
+		}
 #if HASH_REPLACE == 0
-	hash_node *next;
+		for (node = &hash[i]; node != NULL; node = node->next) {
+			write_entry(f, i, node);
+			n++;
+		}
+#else
+		write_entry(f, i, &hash[i]);
+		n++;
 #endif
-	
-    printf("Initializing hash (%lu bytes)...\n", HASHSIZE*sizeof(hash_node));
+	}
+	/* Terminate with an impossible index. */
+	i = UINT32_MAX;
+	fwrite(&i, sizeof(i), 1, f);
+	return n;
+}
 
-    hash_counter = col_counter = miss_counter = 0;
+/* Reads entries written by save_hash() into the current generation. Returns
+ * the number of entries read or -1 if f is broken. */
+long load_hash(FILE *f)
+{
+	hash_node *node;
+	hash_node entry;
+	uint32_t i;
+	long n = 0;
+#if HASH_REPLACE == 0
+	hash_node *new;
+#endif
 
-	for (i = 0; i < HASHSIZE; i++) {
-		node = hash[i];
+	while (fread(&i, sizeof(i), 1, f) == 1 && i != UINT32_MAX) {
+		if (i >= hash_size ||
+			fread(entry.bitmap, sizeof(entry.bitmap), 1, f) != 1 ||
+			fread(&entry.res, sizeof(entry.res), 1, f) != 1 ||
+			fread(&entry.move, sizeof(entry.move), 1, f) != 1) {
+			return -1;
+		}
+		node = &hash[i];
 #if HASH_REPLACE == 0
-		while (node != NULL) {
-			next = node->next;
-			free(node);
-			node = next;
+		if (node->gen == generation) {
+			if ((new = malloc(sizeof(hash_node))) == NULL)
+				abort();
+			*new = *node;
+			node->next = new;
+		} else {
+			free_list(node->next);
+			node->next = NULL;
+			hash_counter += 1;
 		}
 #else
-		if (node != NULL) {
-			free (node);
+		if (node->gen != generation) {
+			hash_counter += 1;
 		}
 #endif
-		hash[i] = NULL;
+		node->bitmap[0] = entry.bitmap[0];
+		node->bitmap[1] = entry.bitmap[1];
+		node->res       = entry.res;
+		node->move      = entry.move;
+		node->gen       = generation;
+		n++;
 	}
+	return (i == UINT32_MAX) ? n : -1;
+}
+
+/* Returns the number of used slots. */
+unsigned long hash_entries()
+{
+	collect_stats();
+	return hash_counter;
+}
+
+/* Returns the number of slots. */
+unsigned long hash_slots()
+{
+	return hash_size;
 }
 
-/* Prints hash stats. */
+/* Hands the counters of the calling thread over to the thread printing the
+ * stats. Worker threads call this before they end. */
+void merge_hash_stats()
+{
+	pthread_mutex_lock(&merge_lock);
+	merged_hash      += hash_counter;
+	merged_col       += col_counter;
+	merged_upd       += upd_counter;
+	merged_miss      += miss_counter;
+	merged_deep      += deep_counter;
+	merged_deep_col  += deep_col_counter;
+	merged_deep_miss += deep_miss_counter;
+	pthread_mutex_unlock(&merge_lock);
+	hash_counter = col_counter = upd_counter = miss_counter = 0;
+	deep_counter = deep_col_counter = deep_miss_counter = 0;
+}
+
+/* Prints hash stats, including those handed over by other threads. */
 void print_hash_stats()
 {
-	printf("Hash entries: %lu, collision: %lu, misses: %lu, "
+	collect_stats();
+	printf("Hash entries: %lu, collision: %lu, updates: %lu, misses: %lu, "
 		   "collision percentage: %lu%%, used: %lu%%.\n",
-		   hash_counter, col_counter, miss_counter,
+		   hash_counter, col_counter, upd_counter, miss_counter,
 		   col_counter*100 / (hash_counter > 0 ? hash_counter : 1),
-		   (hash_counter)*100 / HASHSIZE);
+		   (hash_counter)*100 / hash_size);
+	if (params.deep_hash_ply > -1) {
+		printf("Deep hash from turn %d: entries: %lu, collisions: %lu, "
+			   "misses: %lu, used: %lu%%.\n",
+			   params.deep_hash_ply, deep_counter, deep_col_counter,
+			   deep_miss_counter, deep_counter*100 / deep_size);
+	}
 		
 }
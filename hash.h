@@ -5,30 +5,40 @@
 #ifndef YONMOKUNARABE_HASH_H
 #define YONMOKUNARABE_HASH_H
 
+#include <stdio.h>
 #include "ai.h"
 #include "board.h"
 
-#define HASHSIZE (10 * (1<<(10+10)))   /* Size of internal hash. */
-#define HASH_CUT_OFF -1 /* Don't hash boards after that many turns. Set to -1 to
-                           disable cut-off or to 0 to disable the hash
-                           altogether. A value of around 20 doesn't affect
-                           performance much and safes lots of memory so you can
-                           turn down HASHSIZE by about 10. */
 #define HASH_REPLACE 1  /* Should collisions replace an old slot? Replacing
                            safes plenty of memory and incurs almost no
-                           additional misses. */
+                           additional misses. This changes the layout of the
+                           entries, so unlike the parameters in params.h it
+                           is fixed at compile time. */
+#define HASH_STRIPES 256 /* A shared hash is locked in that many stripes, see
+                            share_hash(). Must be a power of 2. */
 
 typedef struct hash_node {
 	uint64_t bitmap[2];
-	board_state res;
+	uint32_t gen;           /* Generation of the entry. Entries from older
+	                           generations count as empty. */
+	int8_t res;             /* board_state, small to keep entries at 24 bytes */
+	int8_t move;            /* Best or cut-off move, -1 if none. */
 #if HASH_REPLACE == 0
 	struct hash_node *next;
 #endif
 } hash_node;
 
-void init_hash();
-board_state get_hash(board *board);
-board_state set_hash(board *board, board_state res);
+void init_hash(board_size *size);
+void clear_hash();
+void keep_hash(int keep);
+void share_hash(int on);
+board_state get_hash(search_board *board, int *move);
+board_state set_hash(search_board *board, board_state res, int move);
+unsigned long save_hash(FILE *f);
+long load_hash(FILE *f);
+unsigned long hash_entries();
+unsigned long hash_slots();
+void merge_hash_stats();
 void print_hash_stats();
 
 #endif /* end of include guard: YONMOKUNARABE_HASH_H */
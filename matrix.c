@@ -0,0 +1,245 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Solves every board size of a range, each in a process of its own, as the
+ * search keeps its state in globals. Up to jobs solves run at once, the
+ * largest boards first, as they take longest. The memory budget is split
+ * evenly between the solves running at once and limits their hash.
+ *
+ * Finished sizes are appended to the cache file, one line each:
+ *
+ *     WxH result steps seconds
+ *
+ * Sizes found there aren't solved again, so remove the file after changing
+ * the engine.
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for fork(), pipe() and sysconf() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "hash.h"
+#include "matrix.h"
+#include "params.h"
+#include "timer.h"
+
+/* A solve in progress. */
+typedef struct {
+    pid_t pid;
+    int fd;    /* read end of its pipe */
+    int index; /* its entry in the results */
+} matrix_job;
+
+/* Larger boards first, wider ones first among boards of the same area. */
+static int compare_sizes(const void *a, const void *b)
+{
+    const matrix_result *r = a, *s = b;
+    int d = (int) (s->size.x * s->size.y) - (int) (r->size.x * r->size.y);
+
+    return d != 0 ? d : (int) s->size.x - (int) r->size.x;
+}
+
+/* Fills in all results found in the cache. Returns how many there were. */
+static int load_cache(const char *cache, matrix_result results[], int n)
+{
+    FILE *f;
+    char line[128], name[16];
+    board_size size;
+    board_state res;
+    unsigned long steps;
+    double time;
+    int i, found = 0;
+
+    if ((f = fopen(cache, "r")) == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%ux%u %15s %lu %lf", &size.x, &size.y, name,
+                   &steps, &time) != 5) {
+            continue;
+        }
+        for (res = LOSE; res <= WIN; res++) {
+            if (strcmp(name, state_name(res)) == 0) {
+                break;
+            }
+        }
+        for (i = 0; i < n && res <= WIN; i++) {
+            if (results[i].size.x == size.x && results[i].size.y == size.y) {
+                found += !results[i].cached;
+                results[i].res    = res;
+                results[i].steps  = steps;
+                results[i].time   = time;
+                results[i].cached = 1;
+            }
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+/* Appends r to the cache. */
+static void save_result(const char *cache, matrix_result *r)
+{
+    FILE *f;
+
+    if ((f = fopen(cache, "a")) == NULL) {
+        printf("Can't write to %s.\n", cache);
+        return;
+    }
+    fprintf(f, "%dx%d %s %lu %.3f\n", r->size.x, r->size.y,
+            state_name(r->res), r->steps, r->time);
+    fclose(f);
+}
+
+/* Solves the size of r in a child process with at most slots hash entries
+ * and writes r to fd. Doesn't return. */
+static void run_solve(matrix_result *r, unsigned long slots, int fd)
+{
+    solver_params p;
+    board board;
+    double start;
+
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        _exit(1);
+    }
+    init_params(&r->size);
+    p = params;
+    slots = slots > p.deep_hash_size ? slots - p.deep_hash_size : 0;
+    p.hash_size = min(p.hash_size, max(slots, MATRIX_MIN_HASH));
+    fix_params(&p);
+
+    init_board(&board, &r->size);
+    start    = get_time();
+    r->res   = solve(&board);
+    r->time  = get_time() - start;
+    r->steps = ai_steps();
+    destroy_board(&board);
+    _exit(write(fd, r, sizeof(matrix_result)) == sizeof(matrix_result) ?
+          0 : 1);
+}
+
+/* Solves all sizes from from to to (both included), running up to jobs
+ * solves at once (0 means one per core) in memory MB of hash together. Fills
+ * results, largest board first, and returns their number or -1 if the range
+ * is empty. Sizes that failed have the result UNKNOWN. */
+int solve_matrix(board_size *from, board_size *to, int jobs,
+                 unsigned long memory, const char *cache,
+                 matrix_result results[])
+{
+    matrix_job running[MATRIX_MAX_SIZES];
+    matrix_result done;
+    unsigned long slots;
+    unsigned int x, y;
+    int fds[2];
+    int i, n = 0, todo, next = 0, active = 0, status;
+    pid_t pid;
+
+    for (x = from->x; x <= to->x; x++) {
+        for (y = from->y; y <= to->y; y++) {
+            if (x * (y+1) > 64) {
+                printf("Skipping %dx%d, it's too large to encode.\n", x, y);
+                continue;
+            }
+            if (n == MATRIX_MAX_SIZES) {
+                printf("Skipping %dx%d, too many sizes.\n", x, y);
+                continue;
+            }
+            memset(&results[n], 0, sizeof(matrix_result));
+            results[n].size.x = x;
+            results[n].size.y = y;
+            results[n].res    = UNKNOWN;
+            n++;
+        }
+    }
+    if (n == 0) {
+        printf("No board sizes between %dx%d and %dx%d.\n",
+               from->x, from->y, to->x, to->y);
+        return -1;
+    }
+    qsort(results, n, sizeof(matrix_result), compare_sizes);
+    todo = n - load_cache(cache, results, n);
+
+    if (jobs <= 0) {
+        jobs = max(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    jobs  = max(1, min(min(jobs, todo), MATRIX_MAX_SIZES));
+    slots = (memory << 20) / jobs / sizeof(hash_node);
+    printf("Solving %d board size(s), %d cached, %d at once with %luMB of "
+           "hash each.\n", todo, n - todo, jobs, memory / jobs);
+
+    for (;;) {
+        /* Keep all jobs busy. */
+        while (active < jobs && next < n) {
+            if (results[next].cached) {
+                next++;
+                continue;
+            }
+            fflush(stdout);
+            if (pipe(fds) < 0 || (pid = fork()) < 0) {
+                printf("Can't start a solve.\n");
+                abort();
+            }
+            if (pid == 0) {
+                close(fds[0]);
+                run_solve(&results[next], slots, fds[1]);
+            }
+            close(fds[1]);
+            printf("Started %dx%d.\n", results[next].size.x,
+                   results[next].size.y);
+            running[active].pid   = pid;
+            running[active].fd    = fds[0];
+            running[active].index = next++;
+            active++;
+        }
+        if (active == 0) {
+            break;
+        }
+
+        fflush(stdout);
+        if ((pid = wait(&status)) < 0) {
+            abort();
+        }
+        for (i = 0; i < active && running[i].pid != pid; i++)
+            ;
+        if (i == active) {
+            continue; /* not one of ours */
+        }
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+            read(running[i].fd, &done, sizeof(done)) == sizeof(done)) {
+            results[running[i].index] = done;
+            save_result(cache, &done);
+            printf("Solved %dx%d: %s in %.3fs, %lu steps.\n", done.size.x,
+                   done.size.y, state_name(done.res), done.time, done.steps);
+        } else {
+            printf("Solving %dx%d failed.\n",
+                   results[running[i].index].size.x,
+                   results[running[i].index].size.y);
+        }
+        close(running[i].fd);
+        running[i] = running[--active];
+    }
+    return n;
+}
+
+/* Prints results as a table. */
+void print_matrix(matrix_result results[], int n)
+{
+    int i;
+
+    printf("size   result     seconds           steps\n");
+    for (i = 0; i < n; i++) {
+        printf("%2dx%-3d %-6s %11.3f %15lu%s\n", results[i].size.x,
+               results[i].size.y,
+               results[i].res == UNKNOWN ? "failed" :
+               state_name(results[i].res),
+               results[i].time, results[i].steps,
+               results[i].cached ? " (cached)" : "");
+    }
+}
@@ -0,0 +1,30 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_MATRIX_H
+#define YONMOKUNARABE_MATRIX_H
+
+#include "ai.h"
+#include "board.h"
+
+#define MATRIX_MAX_SIZES 64
+#define MATRIX_MEMORY 1024 /* Default hash memory of all solves in MB. */
+#define MATRIX_MIN_HASH (1<<16) /* Fewest hash slots a solve gets. */
+#define MATRIX_CACHE "yonmokunarabe.results" /* Results of finished sizes. */
+
+/* Result of a single board size. */
+typedef struct {
+    board_size size;
+    board_state res;     /* UNKNOWN if the solve failed */
+    unsigned long steps;
+    double time;         /* seconds */
+    int cached;          /* taken from the cache instead of solved? */
+} matrix_result;
+
+int solve_matrix(board_size *from, board_size *to, int jobs,
+                 unsigned long memory, const char *cache,
+                 matrix_result results[]);
+void print_matrix(matrix_result results[], int n);
+
+#endif /* end of include guard: YONMOKUNARABE_MATRIX_H */
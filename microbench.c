@@ -0,0 +1,266 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Times the primitives of the search on their own, over random positions of
+ * each given board size:
+ *
+ *     ./microbench [-o FILE] [WxH ...]
+ *
+ * Every primitive is run MICRO_WARMUP times untimed, then MICRO_RUNS times
+ * timed. Each run calls it MICRO_REPEAT times for every position. Results are
+ * JSON lines, one per primitive and size, with percentiles over the runs in
+ * ns per call.
+ *
+ * Last come whole searches of MICRO_SEARCHES late positions, with alpha_beta()
+ * and recursive_alpha_beta() in turns.
+ *
+ * Only the JSON goes to stdout. Everything the solver prints while setting up
+ * boards and tables goes to stderr.
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for fdopen() and dup() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "corpus.h"
+#include "endgame.h"
+#include "eval.h"
+#include "hash.h"
+#include "params.h"
+#include "timer.h"
+
+#define MICRO_POSITIONS 4096 /* random positions per board size */
+#define MICRO_REPEAT 4       /* calls per position and run */
+#define MICRO_WARMUP 10      /* untimed runs */
+#define MICRO_RUNS 101       /* timed runs */
+#define MICRO_SEED 108
+#define MICRO_SEARCHES 32     /* positions for whole searches */
+#define MICRO_SEARCH_EMPTY 16 /* empty fields in them */
+
+short verbose = 0;
+
+static board boards[MICRO_POSITIONS];
+static search_board sbs[MICRO_POSITIONS];
+static int cols[MICRO_POSITIONS]; /* a free column of each position */
+static board search_boards[MICRO_SEARCHES];
+static search_board searches[MICRO_SEARCHES];
+
+static double samples[MICRO_RUNS]; /* ns per call of each run */
+static volatile uint64_t sink;     /* keeps results from being optimized out */
+
+/* Times BODY, which may use I as the index of the current position, and
+ * writes the result for primitive NAME to OUT. */
+#define MICRO(OUT, SIZE, I, NAME, ...) do {                                \
+    int run_, rep_;                                                        \
+    double start_;                                                         \
+    for (run_ = -MICRO_WARMUP; run_ < MICRO_RUNS; run_++) {                \
+        start_ = get_time();                                               \
+        for (rep_ = 0; rep_ < MICRO_REPEAT; rep_++) {                      \
+            for (I = 0; I < MICRO_POSITIONS; I++) {                        \
+                __VA_ARGS__;                                               \
+            }                                                              \
+        }                                                                  \
+        if (run_ >= 0) {                                                   \
+            samples[run_] = (get_time() - start_) * 1e9 /                  \
+                            (MICRO_REPEAT * MICRO_POSITIONS);              \
+        }                                                                  \
+    }                                                                      \
+    report(OUT, SIZE, NAME, MICRO_REPEAT * MICRO_POSITIONS);               \
+} while (0)
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Returns the p-th percentile of the sorted samples. */
+static double percentile(int p)
+{
+    return samples[(MICRO_RUNS - 1) * p / 100];
+}
+
+/* Writes the stats of the last primitive as a JSON line. */
+static void report(FILE *out, board_size *size, const char *name, int calls)
+{
+    qsort(samples, MICRO_RUNS, sizeof(double), compare_double);
+    fprintf(out, "{\"size\":\"%dx%d\",\"primitive\":\"%s\",\"runs\":%d,"
+            "\"calls\":%d,\"min_ns\":%.2f,\"median_ns\":%.2f,"
+            "\"p90_ns\":%.2f,\"p99_ns\":%.2f}\n",
+            size->x, size->y, name, MICRO_RUNS,
+            calls, samples[0], percentile(50),
+            percentile(90), percentile(99));
+    fflush(out);
+}
+
+/* Fills the pool with random unfinished positions of size. */
+static void init_positions(board_size *size, uint64_t *state)
+{
+    int i, ply;
+
+    for (i = 0; i < MICRO_POSITIONS; i++) {
+        init_board(&boards[i], size);
+        do {
+            ply = splitmix64(state) % (boards[i].max_turns - 1);
+        } while (!random_position(&boards[i], ply, state));
+        do {
+            cols[i] = splitmix64(state) % size->x;
+        } while (!column_free(&boards[i], cols[i]));
+        init_search_board(&sbs[i], &boards[i]);
+    }
+    for (i = 0; i < MICRO_SEARCHES; i++) {
+        init_board(&search_boards[i], size);
+        ply = max(0, (int)search_boards[i].max_turns - MICRO_SEARCH_EMPTY);
+        while (!random_position(&search_boards[i], ply, state))
+            ;
+        init_search_board(&searches[i], &search_boards[i]);
+    }
+}
+
+/* Returns ns per whole search of all search positions, each starting with an
+ * empty hash. */
+static double time_searches(board_state (*search)(search_board *,
+                                                  board_state, board_state))
+{
+    double start = get_time();
+    int i;
+
+    for (i = 0; i < MICRO_SEARCHES; i++) {
+        clear_hash();
+        sink += search(&searches[i], LOSE, WIN);
+    }
+    return (get_time() - start) * 1e9 / MICRO_SEARCHES;
+}
+
+/* Times alpha_beta() against recursive_alpha_beta(). Runs alternate, so both
+ * see the hash warm up the same way. */
+static void searchbench(FILE *out, board_size *size)
+{
+    static double iterative[MICRO_RUNS];
+    double t;
+    int run;
+
+    for (run = -MICRO_WARMUP; run < MICRO_RUNS; run++) {
+        t = time_searches(alpha_beta);
+        if (run >= 0) {
+            iterative[run] = t;
+        }
+        t = time_searches(recursive_alpha_beta);
+        if (run >= 0) {
+            samples[run] = t;
+        }
+    }
+    report(out, size, "recursive_alpha_beta", MICRO_SEARCHES);
+    memcpy(samples, iterative, sizeof(samples));
+    report(out, size, "alpha_beta", MICRO_SEARCHES);
+}
+
+/* Times all primitives on boards of size. */
+static void microbench(FILE *out, board_size *size, uint64_t *state)
+{
+    uint64_t own, opp, bit;
+    int i, j;
+    int moves[MAX_COLS];
+
+    init_params(size);
+    init_hash(size);
+    init_eval(size);
+    init_reorder(size);
+    init_positions(size, state);
+
+    MICRO(out, size, i, "bitmap_has_won",
+          sink += bitmap_has_won(sbs[i].bitmap[sbs[i].player], size->y));
+    MICRO(out, size, i, "has_won",
+          sink += has_won(&boards[i], boards[i].player));
+    MICRO(out, size, i, "move_undo",
+          move(&boards[i], cols[i]); sink += boards[i].hash;
+          undo(&boards[i], 1));
+    MICRO(out, size, i, "fast_move_undo",
+          fast_move(&boards[i], cols[i], boards[i].player);
+          sink += boards[i].bitmap[boards[i].player];
+          fast_undo(&boards[i], cols[i], boards[i].player));
+    MICRO(out, size, i, "search_move_undo",
+          search_move(&sbs[i], cols[i]); sink += sbs[i].hash;
+          search_undo(&sbs[i], cols[i]));
+    MICRO(out, size, i, "search_wins_with",
+          sink += search_wins_with(&sbs[i], cols[i], sbs[i].player));
+    /* Finding all wins and threats of a node, by trial moves and through
+     * the masks of winning fields. */
+    MICRO(out, size, i, "threat_scan_trial",
+          for (j = 0; j < size->x; j++) {
+              if (search_column_free(&sbs[i], j)) {
+                  sink += search_wins_with(&sbs[i], j, WHITE) +
+                          search_wins_with(&sbs[i], j, BLACK);
+              }
+          });
+    MICRO(out, size, i, "threat_scan_masks",
+          own = search_wins(&sbs[i], WHITE);
+          opp = search_wins(&sbs[i], BLACK);
+          for (j = 0; j < size->x; j++) {
+              if (search_column_free(&sbs[i], j)) {
+                  bit   = search_move_bit(&sbs[i], j);
+                  sink += ((own & bit) != 0) + ((opp & bit) != 0);
+              }
+          });
+    MICRO(out, size, i, "set_hash",
+          sink += set_hash(&sbs[i], DRAW, cols[i]));
+    MICRO(out, size, i, "get_hash",
+          sink += get_hash(&sbs[i], &j));
+    MICRO(out, size, i, "parity_eval",
+          sink += parity_eval(&sbs[i]));
+    MICRO(out, size, i, "line_eval",
+          sink += line_eval(&sbs[i]));
+    MICRO(out, size, i, "reorder_moves",
+          for (j = 0; j < size->x; j++) moves[j] = j;
+          reorder_moves(&sbs[i], moves);
+          sink += moves[0]);
+
+    init_endgame(size);
+    searchbench(out, size);
+
+    for (i = 0; i < MICRO_POSITIONS; i++) {
+        destroy_board(&boards[i]);
+    }
+    for (i = 0; i < MICRO_SEARCHES; i++) {
+        destroy_board(&search_boards[i]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    board_size size = {7, 6};
+    uint64_t state = MICRO_SEED;
+    FILE *out;
+    int i = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+        if ((out = fopen(argv[2], "w")) == NULL) {
+            printf("Can't write to %s.\n", argv[2]);
+            return 1;
+        }
+        i = 3;
+    } else if ((out = fdopen(dup(STDOUT_FILENO), "w")) == NULL) {
+        return 1;
+    }
+    /* Status messages of the solver go to stderr from here on. */
+    fflush(stdout);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    if (i >= argc) {
+        microbench(out, &size, &state);
+    }
+    for (; i < argc; i++) {
+        if (sscanf(argv[i], "%ux%u", &size.x, &size.y) != 2 ||
+            size.x == 0 || size.y == 0 || size.x > MAX_COLS) {
+            printf("Invalid size %s. Use WIDTHxHEIGHT, like 7x6.\n", argv[i]);
+            return 1;
+        }
+        microbench(out, &size, &state);
+    }
+    fclose(out);
+    return 0;
+}
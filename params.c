@@ -0,0 +1,194 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Runtime solver parameters. A config file holds one line per board size:
+ *
+ *     # comment
+ *     6x5 hash_size=10485760 hash_cut_off=-1 reorder_depth=10 use_symmetry=1
+ *     symmetry_cut_off=10 endgame_empty=6 deep_hash_ply=-1
+ *     deep_hash_size=32768 killer_depth=10 countermove_depth=-1
+ *
+ * (all on a single line). Missing keys keep their defaults.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "params.h"
+
+#define PARAMS_MAX_LINE 256
+#define PARAMS_MAX_LINES 256
+
+/* Parameters of the current search. */
+solver_params params = {
+    HASHSIZE, HASH_CUT_OFF, REORDER_DEPTH, USE_SYMMETRY, SYMMETRY_CUT_OFF,
+    ENDGAME_EMPTY, DEEP_HASH_PLY, DEEP_HASH_SIZE, KILLER_DEPTH,
+    COUNTERMOVE_DEPTH
+};
+
+static int fixed = 0; /* Ignore the config file? */
+
+/* Sets p to the compiled-in defaults. */
+void default_params(solver_params *p)
+{
+    p->hash_size         = HASHSIZE;
+    p->hash_cut_off      = HASH_CUT_OFF;
+    p->reorder_depth     = REORDER_DEPTH;
+    p->use_symmetry      = USE_SYMMETRY;
+    p->symmetry_cut_off  = SYMMETRY_CUT_OFF;
+    p->endgame_empty     = ENDGAME_EMPTY;
+    p->deep_hash_ply     = DEEP_HASH_PLY;
+    p->deep_hash_size    = DEEP_HASH_SIZE;
+    p->killer_depth      = KILLER_DEPTH;
+    p->countermove_depth = COUNTERMOVE_DEPTH;
+}
+
+/* Returns the config file to use. */
+const char *params_file()
+{
+    const char *file = getenv("YONMOKUNARABE_CONF");
+    return file != NULL ? file : PARAMS_FILE;
+}
+
+/* Sets parameters for boards of the given size: the defaults, overridden by
+ * the config file. Does nothing after fix_params(). */
+void init_params(board_size *size)
+{
+    if (fixed) {
+        return;
+    }
+    default_params(&params);
+    if (load_params(params_file(), size, &params)) {
+        printf("Loaded parameters from %s: ", params_file());
+        print_params(stdout, &params);
+    }
+}
+
+/* Uses p for all following searches and ignores the config file. Pass NULL to
+ * go back to init_params() behaviour. */
+void fix_params(solver_params *p)
+{
+    if (p == NULL) {
+        fixed = 0;
+    } else {
+        params = *p;
+        fixed  = 1;
+    }
+}
+
+/* Applies a single key=value to p. Returns 0 on success, -1 otherwise. */
+static int parse_param(char *pair, solver_params *p)
+{
+    char *value = strchr(pair, '=');
+
+    if (value == NULL) {
+        return -1;
+    }
+    *value++ = '\0';
+    if (strcmp(pair, "hash_size") == 0) {
+        p->hash_size = strtoul(value, NULL, 10);
+    } else if (strcmp(pair, "hash_cut_off") == 0) {
+        p->hash_cut_off = (int) strtol(value, NULL, 10);
+    } else if (strcmp(pair, "reorder_depth") == 0) {
+        p->reorder_depth = (int) strtol(value, NULL, 10);
+    } else if (strcmp(pair, "use_symmetry") == 0) {
+        p->use_symmetry = (int) strtol(value, NULL, 10);
+    } else if (strcmp(pair, "symmetry_cut_off") == 0) {
+        p->symmetry_cut_off = (int) strtol(value, NULL, 10);
+    } else if (strcmp(pair, "endgame_empty") == 0) {
+        p->endgame_empty = (int) strtol(value, NULL, 10);
+    } else if (strcmp(pair, "deep_hash_ply") == 0) {
+        p->deep_hash_ply = (int) strtol(value, NULL, 10);
+    } else if (strcmp(pair, "deep_hash_size") == 0) {
+        p->deep_hash_size = strtoul(value, NULL, 10);
+    } else if (strcmp(pair, "killer_depth") == 0) {
+        p->killer_depth = (int) strtol(value, NULL, 10);
+    } else if (strcmp(pair, "countermove_depth") == 0) {
+        p->countermove_depth = (int) strtol(value, NULL, 10);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/* Reads the parameters for size from file into p. Returns 1 if there were
+ * any, 0 otherwise. */
+int load_params(const char *file, board_size *size, solver_params *p)
+{
+    FILE *in;
+    char line[PARAMS_MAX_LINE];
+    char *tok;
+    unsigned int x, y;
+    int found = 0;
+
+    if ((in = fopen(file, "r")) == NULL) {
+        return 0;
+    }
+    while (!found && fgets(line, sizeof(line), in) != NULL) {
+        if (line[0] == '#' || sscanf(line, "%ux%u", &x, &y) != 2 ||
+            x != size->x || y != size->y) {
+            continue;
+        }
+        found = 1;
+        strtok(line, " \t\n");
+        while ((tok = strtok(NULL, " \t\n")) != NULL) {
+            if (parse_param(tok, p) < 0) {
+                printf("Unknown parameter in %s: %s\n", file, tok);
+            }
+        }
+    }
+    fclose(in);
+    if (p->hash_size == 0) {
+        p->hash_size = 1;
+    }
+    if (p->deep_hash_size == 0) {
+        p->deep_hash_size = 1;
+    }
+    return found;
+}
+
+/* Writes p as the parameters for size into file, replacing the old line for
+ * that size. Returns 0 on success, -1 otherwise. */
+int save_params(const char *file, board_size *size, solver_params *p)
+{
+    FILE *f;
+    char lines[PARAMS_MAX_LINES][PARAMS_MAX_LINE];
+    unsigned int x, y;
+    int i, n = 0;
+
+    if ((f = fopen(file, "r")) != NULL) {
+        while (n < PARAMS_MAX_LINES && fgets(lines[n], PARAMS_MAX_LINE, f)) {
+            if (sscanf(lines[n], "%ux%u", &x, &y) == 2 &&
+                x == size->x && y == size->y) {
+                continue;
+            }
+            n++;
+        }
+        fclose(f);
+    }
+
+    if ((f = fopen(file, "w")) == NULL) {
+        printf("Can't write to %s.\n", file);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        fputs(lines[i], f);
+    }
+    fprintf(f, "%dx%d ", size->x, size->y);
+    print_params(f, p);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/* Prints p as a config line, without the size. */
+void print_params(FILE *out, solver_params *p)
+{
+    fprintf(out, "hash_size=%lu hash_cut_off=%d reorder_depth=%d "
+            "use_symmetry=%d symmetry_cut_off=%d endgame_empty=%d "
+            "deep_hash_ply=%d deep_hash_size=%lu killer_depth=%d "
+            "countermove_depth=%d\n",
+            p->hash_size, p->hash_cut_off, p->reorder_depth,
+            p->use_symmetry, p->symmetry_cut_off, p->endgame_empty,
+            p->deep_hash_ply, p->deep_hash_size, p->killer_depth,
+            p->countermove_depth);
+}
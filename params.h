@@ -0,0 +1,64 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_PARAMS_H
+#define YONMOKUNARABE_PARAMS_H
+
+#include <stdio.h>
+#include "board.h"
+
+/* Defaults of the solver parameters. Which values pay off depends a lot on
+ * the board size, so measure with --tune instead of guessing. */
+#define HASHSIZE (10 * (1<<(10+10)))   /* Size of internal hash. */
+#define HASH_CUT_OFF -1 /* Don't hash boards after that many turns. Set to -1 to
+                           disable cut-off or to 0 to disable the hash
+                           altogether. */
+#define REORDER_DEPTH 10 /* Moves are only reordered until this depth. Set to 0
+                            to (kinda) disable reordering. */
+#define USE_SYMMETRY 1 /* Use additional symmetric hash? */
+#define SYMMETRY_CUT_OFF 10 /* Ignore symmetry hash after that many turns. Set
+                               to -1 to turn off cut-off. */
+#define ENDGAME_EMPTY 6 /* Hand boards with at most that many empty fields over
+                           to the endgame solver. Set to 0 to disable it. */
+#define DEEP_HASH_PLY -1 /* Boards from that turn on go to the deep hash instead
+                            of the main one. Set to -1 to use only the main
+                            hash. */
+#define DEEP_HASH_SIZE (1<<15) /* Slots in the deep hash. 24 bytes each, so
+                                  this fits in L2. */
+#define KILLER_DEPTH 10 /* From that turn on, try the last two cut-off moves
+                           of the same depth right after the hash move. Above
+                           it, they only get in the way of the move scores.
+                           Set to -1 to disable killers. */
+#define COUNTERMOVE_DEPTH -1 /* Same for the last cut-off answer to the
+                                opponent's last move. Doesn't add anything to
+                                the killers so far. */
+
+#define PARAMS_FILE "yonmokunarabe.conf" /* Config loaded by init_params(),
+                                            unless YONMOKUNARABE_CONF names
+                                            another one. */
+
+typedef struct {
+    unsigned long hash_size;   /* slots in the hash */
+    int hash_cut_off;          /* see HASH_CUT_OFF */
+    int reorder_depth;         /* see REORDER_DEPTH */
+    int use_symmetry;          /* see USE_SYMMETRY */
+    int symmetry_cut_off;      /* see SYMMETRY_CUT_OFF */
+    int endgame_empty;         /* see ENDGAME_EMPTY */
+    int deep_hash_ply;         /* see DEEP_HASH_PLY */
+    unsigned long deep_hash_size; /* see DEEP_HASH_SIZE */
+    int killer_depth;          /* see KILLER_DEPTH */
+    int countermove_depth;     /* see COUNTERMOVE_DEPTH */
+} solver_params;
+
+extern solver_params params;
+
+void default_params(solver_params *p);
+void init_params(board_size *size);
+void fix_params(solver_params *p);
+const char *params_file();
+int load_params(const char *file, board_size *size, solver_params *p);
+int save_params(const char *file, board_size *size, solver_params *p);
+void print_params(FILE *out, solver_params *p);
+
+#endif /* end of include guard: YONMOKUNARABE_PARAMS_H */
@@ -0,0 +1,224 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Move generation benchmark. Walks the game tree with the plain board API and
+ * counts the positions at each ply. Finished games aren't expanded.
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for sysconf() */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "board.h"
+#include "common.h"
+#include "perft.h"
+#include "timer.h"
+
+/* Set of already seen positions, shared by all threads. Each stripe is an
+ * open-addressing table of its own, so a single lock per stripe suffices. */
+typedef struct {
+    uint64_t *keys;                   /* 0 marks an empty slot */
+    unsigned long stripe_size;        /* slots per stripe, a power of 2 */
+    unsigned long overflow;           /* inserts into full stripes */
+    pthread_mutex_t locks[PERFT_SET_STRIPES];
+} perft_set;
+
+/* Work shared by all threads. Root moves are handed out one at a time. */
+typedef struct {
+    board *root;
+    int depth;
+    perft_set *set;                   /* NULL unless counting distinct */
+    int next_col;                     /* next root move to hand out */
+    pthread_mutex_t lock;
+} perft_shared;
+
+typedef struct {
+    perft_shared *shared;
+    pthread_t thread;
+    uint64_t counts[PERFT_MAX_PLY+1];
+} perft_worker;
+
+/* Inserts board into set. Returns 1 if it wasn't seen before, 0 otherwise.
+ * The key is unique because the mask has an empty bit on top of each column;
+ * it is never 0 once a stone has been played. */
+static int set_insert(perft_set *set, board *board)
+{
+    uint64_t key, h, *stripe;
+    unsigned long s, i, n;
+    int res = 1;
+
+    key = board->bitmap[WHITE] + (board->bitmap[WHITE] | board->bitmap[BLACK]);
+    h   = key * UINT64_C(0x9E3779B97F4A7C15);
+    s   = h >> 58;
+    i   = (h >> 26) & (set->stripe_size - 1);
+    stripe = set->keys + s * set->stripe_size;
+
+    pthread_mutex_lock(&set->locks[s]);
+    for (n = 0; n < set->stripe_size; n++) {
+        if (stripe[i] == 0) {
+            stripe[i] = key;
+            break;
+        }
+        if (stripe[i] == key) {
+            res = 0;
+            break;
+        }
+        i = (i + 1) & (set->stripe_size - 1);
+    }
+    if (n == set->stripe_size) {
+        /* Full. Count it as new so we at least terminate. */
+        set->overflow += 1;
+    }
+    pthread_mutex_unlock(&set->locks[s]);
+    return res;
+}
+
+/* Counts board at ply and expands it until depth is reached. */
+static void perft_rec(board *board, int ply, perft_worker *w)
+{
+    int i;
+
+    w->counts[ply] += 1;
+    if (ply >= w->shared->depth || board->turn >= board->max_turns) {
+        return;
+    }
+    if (board->turn > 0 && has_won(board, board->player^1)) {
+        return;
+    }
+
+    for (i = 0; i < board->size->x; i++) {
+        if (column_free(board, i)) {
+            move(board, i);
+            if (w->shared->set == NULL || set_insert(w->shared->set, board)) {
+                perft_rec(board, ply+1, w);
+            }
+            undo(board, 1);
+        }
+    }
+}
+
+/* Thread main loop. Grabs root moves until none are left. */
+static void *perft_thread(void *arg)
+{
+    perft_worker *w = arg;
+    perft_shared *shared = w->shared;
+    board board;
+    int col;
+
+    copy_board(&board, shared->root);
+    for (;;) {
+        pthread_mutex_lock(&shared->lock);
+        col = shared->next_col++;
+        pthread_mutex_unlock(&shared->lock);
+        if (col >= board.size->x) {
+            break;
+        }
+        if (column_free(&board, col)) {
+            move(&board, col);
+            if (shared->set == NULL || set_insert(shared->set, &board)) {
+                perft_rec(&board, 1, w);
+            }
+            undo(&board, 1);
+        }
+    }
+    destroy_board(&board);
+    return NULL;
+}
+
+/* Counts positions at each ply up to depth, starting at board, using the given
+ * number of threads (0 means one per core). With distinct set, transpositions
+ * are only counted and expanded once. */
+void perft(board *board, int depth, int threads, int distinct,
+           perft_result *res)
+{
+    perft_shared shared;
+    perft_set set;
+    perft_worker *workers;
+    double start;
+    int i, j;
+
+    if (threads <= 0) {
+        threads = max(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    threads = min(threads, board->size->x);
+    depth   = min(depth, board->max_turns - board->turn);
+    depth   = min(depth, PERFT_MAX_PLY);
+
+    memset(res, 0, sizeof(perft_result));
+    res->depth      = depth;
+    shared.root     = board;
+    shared.depth    = depth;
+    shared.set      = NULL;
+    shared.next_col = 0;
+    pthread_mutex_init(&shared.lock, NULL);
+
+    if (distinct) {
+        set.stripe_size = PERFT_SET_SIZE / PERFT_SET_STRIPES;
+        set.overflow    = 0;
+        if ((set.keys = calloc(PERFT_SET_SIZE, sizeof(uint64_t))) == NULL)
+            abort();
+        for (i = 0; i < PERFT_SET_STRIPES; i++) {
+            pthread_mutex_init(&set.locks[i], NULL);
+        }
+        shared.set = &set;
+    }
+
+    if ((workers = calloc(threads, sizeof(perft_worker))) == NULL)
+        abort();
+
+    printf("Perft to depth %d with %d thread(s)%s...\n", depth, threads,
+           distinct ? ", counting distinct positions" : "");
+    start = get_time();
+
+    res->counts[0] = 1;
+    if (depth > 0 && !(board->turn > 0 && has_won(board, board->player^1))) {
+        for (i = 0; i < threads; i++) {
+            workers[i].shared = &shared;
+            if (pthread_create(&workers[i].thread, NULL, perft_thread,
+                               &workers[i]) != 0)
+                abort();
+        }
+        for (i = 0; i < threads; i++) {
+            pthread_join(workers[i].thread, NULL);
+            for (j = 0; j <= depth; j++) {
+                res->counts[j] += workers[i].counts[j];
+            }
+        }
+    }
+
+    res->time = get_time() - start;
+    for (j = 0; j <= depth; j++) {
+        res->nodes += res->counts[j];
+    }
+
+    if (distinct) {
+        res->overflow = set.overflow;
+        for (i = 0; i < PERFT_SET_STRIPES; i++) {
+            pthread_mutex_destroy(&set.locks[i]);
+        }
+        free(set.keys);
+    }
+    pthread_mutex_destroy(&shared.lock);
+    free(workers);
+}
+
+/* Prints counts for each ply and overall speed. */
+void print_perft(perft_result *res)
+{
+    int i;
+
+    for (i = 0; i <= res->depth; i++) {
+        printf("ply %2d: %" PRIu64 "\n", i, res->counts[i]);
+    }
+    if (res->overflow > 0) {
+        printf("Warning: set full, %lu positions may be counted twice.\n",
+               res->overflow);
+    }
+    printf("Done. %" PRIu64 " nodes in %.3fs (%.0f nodes/s).\n",
+           res->nodes, res->time,
+           res->nodes / (res->time > 0 ? res->time : 1e-9));
+}
@@ -0,0 +1,28 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_PERFT_H
+#define YONMOKUNARABE_PERFT_H
+
+#include <stdint.h>
+#include "board.h"
+
+#define PERFT_MAX_PLY 64        /* More plies don't fit into a bitmap anyway. */
+#define PERFT_SET_SIZE (1<<23)  /* Slots in the set of distinct positions. */
+#define PERFT_SET_STRIPES 64    /* The set is split into that many
+                                   independently locked stripes. */
+
+typedef struct {
+    int depth;                        /* depth actually searched */
+    uint64_t counts[PERFT_MAX_PLY+1]; /* positions at each ply after start */
+    uint64_t nodes;                   /* sum of all counts */
+    unsigned long overflow;           /* positions that didn't fit the set */
+    double time;                      /* wall clock seconds */
+} perft_result;
+
+void perft(board *board, int depth, int threads, int distinct,
+           perft_result *res);
+void print_perft(perft_result *res);
+
+#endif /* end of include guard: YONMOKUNARABE_PERFT_H */
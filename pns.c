@@ -0,0 +1,293 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Proof-number search. Proves or disproves that one player (the attacker)
+ * wins; a draw counts as a disproof. Two such searches give the same result
+ * as solve(). The tree lives in a fixed pool of nodes. When it runs out,
+ * subtrees of already solved nodes are thrown away, as their value is all we
+ * need.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "pns.h"
+#include "timer.h"
+
+/* Returns a fresh node or -1 if the pool is exhausted. */
+static int32_t pool_alloc(pn_pool *pool)
+{
+    int32_t n;
+
+    if (pool->free_list >= 0) {
+        n = pool->free_list;
+        pool->free_list = pool->nodes[n].sibling;
+    } else if (pool->top < pool->size) {
+        n = pool->top++;
+    } else {
+        return -1;
+    }
+    pool->used += 1;
+    pool->peak  = max(pool->peak, pool->used);
+    return n;
+}
+
+/* Returns node n and its whole subtree to the pool. */
+static void pool_free(pn_pool *pool, int32_t n)
+{
+    int32_t c, next;
+
+    for (c = pool->nodes[n].child; c >= 0; c = next) {
+        next = pool->nodes[c].sibling;
+        pool_free(pool, c);
+    }
+    pool->nodes[n].sibling = pool->free_list;
+    pool->free_list = n;
+    pool->used -= 1;
+}
+
+/* Frees the children of all solved nodes below n. */
+static void pool_collect(pn_pool *pool, int32_t n)
+{
+    pn_node *node = &pool->nodes[n];
+    int32_t c, next;
+
+    if (node->child < 0) {
+        return;
+    }
+    if (node->proof == 0 || node->disproof == 0) {
+        for (c = node->child; c >= 0; c = next) {
+            next = pool->nodes[c].sibling;
+            pool_free(pool, c);
+        }
+        node->child = -1;
+    } else {
+        for (c = node->child; c >= 0; c = pool->nodes[c].sibling) {
+            pool_collect(pool, c);
+        }
+    }
+}
+
+/* Saturating addition, solved stays solved. */
+static uint32_t pn_add(uint32_t a, uint32_t b)
+{
+    return (a >= PNS_INF - b) ? PNS_INF : a + b;
+}
+
+/* Recalculates proof and disproof number of an expanded node from its
+ * children. At OR nodes the attacker is to move. */
+static void update_node(pn_pool *pool, int32_t n, int or_node)
+{
+    pn_node *node = &pool->nodes[n];
+    pn_node *child;
+    uint32_t p, d;
+    int32_t c;
+
+    if (node->child < 0) {
+        return;
+    }
+    p = or_node ? PNS_INF : 0;
+    d = or_node ? 0 : PNS_INF;
+    for (c = node->child; c >= 0; c = child->sibling) {
+        child = &pool->nodes[c];
+        if (or_node) {
+            p = min(p, child->proof);
+            d = pn_add(d, child->disproof);
+        } else {
+            p = pn_add(p, child->proof);
+            d = min(d, child->disproof);
+        }
+    }
+    node->proof    = p;
+    node->disproof = d;
+}
+
+/* Adds all moves as children of n. The board must be at n. Returns -1 if the
+ * pool ran out, 0 otherwise. */
+static int expand_node(pn_pool *pool, int32_t n, board *board,
+                       players attacker)
+{
+    pn_node *child;
+    int32_t c, last = -1;
+    players mover = board->player;
+    int forced = -1;
+    int i;
+
+    /* Like alpha_beta(), only look at a winning move or at the block of a
+     * threat if there is one. Everything else loses at once anyway. */
+    for (i = 0; i < board->size->x && forced < 0; i++) {
+        if (column_free(board, i)) {
+            fast_move(board, i, mover);
+            if (has_won(board, mover)) {
+                forced = i;
+            }
+            fast_undo(board, i, mover);
+        }
+    }
+    for (i = 0; i < board->size->x && forced < 0; i++) {
+        if (column_free(board, i)) {
+            fast_move(board, i, mover^1);
+            if (has_won(board, mover^1)) {
+                forced = i;
+            }
+            fast_undo(board, i, mover^1);
+        }
+    }
+
+    for (i = board->size->x - 1; i >= 0; i--) {
+        if (!column_free(board, i) || (forced >= 0 && i != forced)) {
+            continue;
+        }
+        if ((c = pool_alloc(pool)) < 0) {
+            /* Undo the partial expansion. */
+            for (c = last; c >= 0; c = last) {
+                last = pool->nodes[c].sibling;
+                pool->nodes[c].child = -1;
+                pool_free(pool, c);
+            }
+            pool->nodes[n].child = -1;
+            return -1;
+        }
+        child = &pool->nodes[c];
+        child->parent  = n;
+        child->child   = -1;
+        child->sibling = last;
+        child->col     = i;
+        last = c;
+
+        move(board, i);
+        if (has_won(board, mover)) {
+            child->proof    = (mover == attacker) ? 0 : PNS_INF;
+            child->disproof = (mover == attacker) ? PNS_INF : 0;
+        } else if (board->turn >= board->max_turns) {
+            /* A draw is as good as a loss for the attacker. */
+            child->proof    = PNS_INF;
+            child->disproof = 0;
+        } else {
+            child->proof    = 1;
+            child->disproof = 1;
+        }
+        undo(board, 1);
+    }
+    pool->nodes[n].child = last;
+    pool->expanded += 1;
+    return 0;
+}
+
+/* Proof-number search for attacker from the current position. Returns 1 if
+ * the attacker wins, 0 if not, and -1 if the pool was too small. */
+static int pn_search(pn_pool *pool, board *board, players attacker)
+{
+    pn_node *node;
+    int32_t root, n, c, best;
+    int or_node;
+
+    pool->used      = 0;
+    pool->top       = 0;
+    pool->free_list = -1;
+
+    root = pool_alloc(pool);
+    node = &pool->nodes[root];
+    node->parent  = -1;
+    node->child   = -1;
+    node->sibling = -1;
+    node->col     = -1;
+    node->proof   = 1;
+    node->disproof = 1;
+
+    while (pool->nodes[root].proof != 0 && pool->nodes[root].disproof != 0) {
+        /* Walk down to the most-proving node. */
+        n = root;
+        or_node = (board->player == attacker);
+        while (pool->nodes[n].child >= 0) {
+            best = -1;
+            for (c = pool->nodes[n].child; c >= 0; c = pool->nodes[c].sibling) {
+                if (best < 0 ||
+                    ( or_node && pool->nodes[c].proof
+                                 < pool->nodes[best].proof) ||
+                    (!or_node && pool->nodes[c].disproof
+                                 < pool->nodes[best].disproof)) {
+                    best = c;
+                }
+            }
+            n = best;
+            move(board, pool->nodes[n].col);
+            or_node ^= 1;
+        }
+
+        if (expand_node(pool, n, board, attacker) < 0) {
+            /* Out of nodes, get rid of solved subtrees and retry. */
+            pool->collections += 1;
+            pool_collect(pool, root);
+            if (expand_node(pool, n, board, attacker) < 0) {
+                while (n != root) {
+                    n = pool->nodes[n].parent;
+                    undo(board, 1);
+                }
+                return -1;
+            }
+        }
+
+        /* Back up the new numbers. */
+        while (n != root) {
+            update_node(pool, n, or_node);
+            n = pool->nodes[n].parent;
+            undo(board, 1);
+            or_node ^= 1;
+        }
+        update_node(pool, root, or_node);
+    }
+    return pool->nodes[root].proof == 0;
+}
+
+/* Solves board via proof-number search, prints result like solve(). memory is
+ * the size of the node pool in MB. */
+board_state pns_solve(board *board, unsigned long memory)
+{
+    board_state res = UNKNOWN;
+    pn_pool pool;
+    double start;
+    players mover = board->player;
+    int won;
+
+    printf("Solving %dx%d board now (proof-number search).\n",
+           board->size->x, board->size->y);
+    print_board(board);
+
+    pool.size = memory * (1<<20) / sizeof(pn_node);
+    pool.size = min(pool.size, (unsigned long) INT32_MAX);
+    printf("Initializing node pool (%lu nodes, %lu bytes)...\n",
+           pool.size, pool.size * sizeof(pn_node));
+    if ((pool.nodes = malloc(pool.size * sizeof(pn_node))) == NULL)
+        abort();
+    pool.peak = pool.expanded = pool.collections = 0;
+
+    printf("Solving...\n");
+    start = get_time();
+    if (board->turn > 0 && has_won(board, mover^1)) {
+        res = LOSE;
+    } else if (board->turn >= board->max_turns) {
+        res = DRAW;
+    } else if ((won = pn_search(&pool, board, mover)) == 1) {
+        res = WIN;
+    } else if (won == 0) {
+        won = pn_search(&pool, board, mover^1);
+        if (won >= 0) {
+            res = won ? LOSE : DRAW;
+        }
+    }
+    if (res == UNKNOWN) {
+        printf("Node pool exhausted.\n");
+    }
+
+    printf("Done. Took %lu steps in %.3fs.\n", pool.expanded,
+           get_time() - start);
+    printf("Pool: peak %lu nodes (%lu bytes), %lu collections.\n",
+           pool.peak, pool.peak * sizeof(pn_node), pool.collections);
+    print_result(res);
+
+    free(pool.nodes);
+    return res;
+}
@@ -0,0 +1,37 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_PNS_H
+#define YONMOKUNARABE_PNS_H
+
+#include <stdint.h>
+#include "ai.h"
+#include "board.h"
+
+#define PNS_MEMORY 512        /* Default size of the node pool in MB. */
+#define PNS_INF (UINT32_MAX/2) /* Proof or disproof number of solved nodes. */
+
+typedef struct {
+    uint32_t proof;           /* proof number */
+    uint32_t disproof;        /* disproof number */
+    int32_t parent;           /* index in pool, -1 for the root */
+    int32_t child;            /* first child, -1 if not expanded */
+    int32_t sibling;          /* next child of the same parent, -1 if last */
+    signed char col;          /* move that led here */
+} pn_node;
+
+typedef struct {
+    pn_node *nodes;           /* preallocated nodes */
+    unsigned long size;       /* number of nodes in pool */
+    unsigned long used;       /* nodes currently allocated */
+    unsigned long peak;       /* maximal nodes allocated at once */
+    unsigned long top;        /* nodes below top were handed out before */
+    int32_t free_list;        /* freed nodes, linked via sibling */
+    unsigned long expanded;   /* expanded nodes */
+    unsigned long collections; /* times solved subtrees were reclaimed */
+} pn_pool;
+
+board_state pns_solve(board *board, unsigned long memory);
+
+#endif /* end of include guard: YONMOKUNARABE_PNS_H */
@@ -0,0 +1,319 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Binary game records, a compact alternative to corpus files. A record file
+ * holds RECORD_MAGIC and the version (uint32_t), then one game after another:
+ * width, height, number of moves and value (one byte each, the value as a
+ * signed board_state), followed by the moves, 4 bits each, two per byte with
+ * the earlier move in the low bits.
+ *
+ * Record files are read through mmap(), so going through them needs neither
+ * parsing nor any allocation per game.
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for mmap() and posix_madvise() */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ai.h"
+#include "board.h"
+#include "corpus.h"
+#include "record.h"
+#include "timer.h"
+
+/* Can boards of size be encoded? */
+static int valid_size(board_size *size)
+{
+    return size->x >= 1 && size->x <= MAX_COLS && size->y >= 1 &&
+           size->y <= 15 && size->x * (size->y+1) <= 64;
+}
+
+/* Returns 1 if file starts like a record file, 0 otherwise. */
+int is_record_file(const char *file)
+{
+    FILE *f;
+    char magic[4];
+    int res = 0;
+
+    if ((f = fopen(file, "rb")) != NULL) {
+        res = fread(magic, 4, 1, f) == 1 && memcmp(magic, RECORD_MAGIC, 4) == 0;
+        fclose(f);
+    }
+    return res;
+}
+
+/* Maps the record file into r. Returns 0 on success, -1 otherwise. */
+int open_records(const char *file, record_reader *r)
+{
+    struct stat st;
+    uint32_t version;
+    void *data;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        printf("Can't open records %s.\n", file);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    if (st.st_size < 8 ||
+        (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+        == MAP_FAILED) {
+        printf("Can't map records %s.\n", file);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    r->data = data;
+    r->size = st.st_size;
+    r->pos  = 8;
+    memcpy(&version, r->data + 4, sizeof(version));
+    if (memcmp(r->data, RECORD_MAGIC, 4) != 0 || version != RECORD_VERSION) {
+        printf("%s is no record file of version %d.\n", file, RECORD_VERSION);
+        close_records(r);
+        return -1;
+    }
+    posix_madvise(data, r->size, POSIX_MADV_SEQUENTIAL);
+    init_zobrist();
+    return 0;
+}
+
+/* Points rec to the next game of r. Returns 1 if there was one, 0 at the end
+ * of the file and -1 if the file is broken. */
+int next_record(record_reader *r, game_record *rec)
+{
+    const unsigned char *p = r->data + r->pos;
+    size_t bytes;
+
+    if (r->pos == r->size) {
+        return 0;
+    }
+    if (r->size - r->pos < RECORD_HEADER) {
+        return -1;
+    }
+    rec->size.x = p[0];
+    rec->size.y = p[1];
+    rec->length = p[2];
+    rec->value  = (int8_t) p[3];
+    rec->moves  = p + RECORD_HEADER;
+    bytes = (rec->length + 1) / 2;
+    if (!valid_size(&rec->size) ||
+        rec->length > rec->size.x * rec->size.y ||
+        (rec->value != UNKNOWN && (rec->value < LOSE || rec->value > WIN)) ||
+        r->size - r->pos - RECORD_HEADER < bytes) {
+        return -1;
+    }
+    r->pos += RECORD_HEADER + bytes;
+    return 1;
+}
+
+/* Unmaps r. */
+void close_records(record_reader *r)
+{
+    munmap((void *) r->data, r->size);
+    r->data = NULL;
+    r->size = r->pos = 0;
+}
+
+/* Sets sb to the position at the end of rec. Returns 0 on success, -1 if rec
+ * holds an illegal move. */
+int record_board(game_record *rec, search_board *sb)
+{
+    unsigned int i;
+    int col;
+
+    init_empty_search_board(sb, &rec->size);
+    for (i = 0; i < rec->length; i++) {
+        col = record_move(rec, i);
+        if (col >= sb->x || !search_column_free(sb, col)) {
+            return -1;
+        }
+        search_move(sb, col);
+    }
+    return 0;
+}
+
+/* Resets board, which must have the size of rec, and plays all moves of rec.
+ * Returns 0 on success, -1 if rec holds an illegal move. */
+int play_record(game_record *rec, board *board)
+{
+    unsigned int i;
+
+    reset(board);
+    for (i = 0; i < rec->length; i++) {
+        if (move(board, record_move(rec, i)) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Writes the header of a record file to out. */
+static void write_record_header(FILE *out)
+{
+    uint32_t version = RECORD_VERSION;
+
+    fwrite(RECORD_MAGIC, 4, 1, out);
+    fwrite(&version, sizeof(version), 1, out);
+}
+
+/* Writes a game of n moves on a board of size with the given value (UNKNOWN
+ * if none) to out. Returns 0 on success, -1 if the game can't be stored. */
+int write_record(FILE *out, board_size *size, int moves[], int n,
+                 board_state value)
+{
+    unsigned char buf[RECORD_HEADER + 32];
+    unsigned int heights[MAX_COLS];
+    int i;
+
+    if (!valid_size(size) || n < 0 || n > (int) (size->x * size->y)) {
+        return -1;
+    }
+    memset(heights, 0, sizeof(heights));
+    memset(buf, 0, sizeof(buf));
+    buf[0] = size->x;
+    buf[1] = size->y;
+    buf[2] = n;
+    buf[3] = (unsigned char) (int8_t) value;
+    for (i = 0; i < n; i++) {
+        if (moves[i] < 0 || moves[i] >= (int) size->x ||
+            heights[moves[i]]++ >= size->y) {
+            return -1;
+        }
+        buf[RECORD_HEADER + (i >> 1)] |= moves[i] << ((i & 1) << 2);
+    }
+    fwrite(buf, RECORD_HEADER + (n + 1) / 2, 1, out);
+    return 0;
+}
+
+/* Converts the corpus in in to a record file written to out. Returns the
+ * number of games written or -1 if in is broken. */
+long text_to_records(FILE *in, FILE *out)
+{
+    char line[CORPUS_MAX_LINE], moves[CORPUS_MAX_LINE];
+    int cols[CORPUS_MAX_LINE];
+    board_size size;
+    board_state value;
+    long count = 0;
+    int i, n;
+
+    write_record_header(out);
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if ((n = parse_corpus_line(line, &size, moves, &value)) == 0) {
+            continue;
+        }
+        for (i = 0; n > 0 && moves[i] != '\0'; i++) {
+            cols[i] = char_move(moves[i]);
+        }
+        if (n < 0 || write_record(out, &size, cols, i, value) < 0) {
+            printf("Broken corpus line: %s", line);
+            return -1;
+        }
+        count++;
+    }
+    return count;
+}
+
+/* Writes all games of the record file as corpus lines to out. Returns the
+ * number of games written or -1 if the file is broken. */
+long records_to_text(const char *file, FILE *out)
+{
+    record_reader r;
+    game_record rec;
+    int cols[64];
+    long count = 0;
+    unsigned int i;
+    int n;
+
+    if (open_records(file, &r) < 0) {
+        return -1;
+    }
+    while ((n = next_record(&r, &rec)) > 0) {
+        for (i = 0; i < rec.length; i++) {
+            cols[i] = record_move(&rec, i);
+        }
+        write_corpus_line(out, &rec.size, cols, rec.length, rec.value);
+        count++;
+    }
+    close_records(&r);
+    if (n < 0) {
+        printf("Broken record file %s.\n", file);
+        return -1;
+    }
+    return count;
+}
+
+/* Like replay_corpus(), but for a record file. Games are searched right out
+ * of the mapped file, and a board is only set up when the size changes. */
+int replay_records(const char *file, board_size *only, corpus_stats *stats)
+{
+    record_reader r;
+    game_record rec;
+    board_size size = {0, 0};
+    board board;
+    search_board sb;
+    board_state res;
+    char moves[65];
+    double start;
+    unsigned int i;
+    int n;
+
+    memset(stats, 0, sizeof(corpus_stats));
+    if (open_records(file, &r) < 0) {
+        return -1;
+    }
+
+    while ((n = next_record(&r, &rec)) > 0) {
+        if (only != NULL &&
+            (rec.size.x != only->x || rec.size.y != only->y)) {
+            continue;
+        }
+        if (record_board(&rec, &sb) < 0) {
+            printf("Illegal game in %s.\n", file);
+            continue;
+        }
+        if (rec.size.x != size.x || rec.size.y != size.y) {
+            if (size.x > 0) {
+                destroy_board(&board);
+            }
+            size = rec.size;
+            init_board(&board, &size);
+        }
+        init_ai(&board);
+
+        start = get_time();
+        res = alpha_beta(&sb, LOSE, WIN);
+        stats->time  += get_time() - start;
+        stats->steps += ai_steps();
+        stats->positions += 1;
+
+        if (rec.value != UNKNOWN) {
+            stats->certified += 1;
+            if (res != rec.value) {
+                stats->mismatches += 1;
+                for (i = 0; i < rec.length; i++) {
+                    moves[i] = move_char(record_move(&rec, i));
+                }
+                moves[i] = '\0';
+                printf("Mismatch: %dx%d %s is %s, alpha-beta says %d.\n",
+                       size.x, size.y, moves, state_name(rec.value), res);
+            }
+        }
+    }
+    if (size.x > 0) {
+        destroy_board(&board);
+    }
+    close_records(&r);
+    if (n < 0) {
+        printf("Broken record file %s.\n", file);
+        return -1;
+    }
+    return stats->mismatches;
+}
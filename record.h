@@ -0,0 +1,52 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_RECORD_H
+#define YONMOKUNARABE_RECORD_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "ai.h"
+#include "board.h"
+#include "corpus.h"
+
+#define RECORD_MAGIC "YMKR"
+#define RECORD_VERSION 1
+#define RECORD_HEADER 4 /* bytes before the moves of each game */
+
+/* A single game of a record file. The moves point right into the file. */
+typedef struct {
+    board_size size;
+    unsigned int length;        /* number of moves */
+    board_state value;          /* value for the player to move, UNKNOWN if
+                                   not certified */
+    const unsigned char *moves; /* 4 bits per move, first move in the low bits */
+} game_record;
+
+/* A record file mapped into memory. */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t pos;                 /* offset of the next game */
+} record_reader;
+
+/* Returns move i of rec. */
+static inline int record_move(game_record *rec, unsigned int i)
+{
+    return (rec->moves[i >> 1] >> ((i & 1) << 2)) & 15;
+}
+
+int is_record_file(const char *file);
+int open_records(const char *file, record_reader *r);
+int next_record(record_reader *r, game_record *rec);
+void close_records(record_reader *r);
+int record_board(game_record *rec, search_board *sb);
+int play_record(game_record *rec, board *board);
+int write_record(FILE *out, board_size *size, int moves[], int n,
+                 board_state value);
+long text_to_records(FILE *in, FILE *out);
+long records_to_text(const char *file, FILE *out);
+int replay_records(const char *file, board_size *only, corpus_stats *stats);
+
+#endif /* end of include guard: YONMOKUNARABE_RECORD_H */
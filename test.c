@@ -4,10 +4,22 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "ai.h"
 #include "board.h"
+#include "checkpoint.h"
 #include "common.h"
+#include "corpus.h"
+#include "db.h"
+#include "eval.h"
 #include "hash.h"
+#include "matrix.h"
+#include "params.h"
+#include "perft.h"
+#include "pns.h"
+#include "record.h"
+#include "tss.h"
+#include "ybw.h"
 
 /* MinUnit */
 #define mu_assert(message, test) do { if (!(test)) return message; } while (0)
@@ -86,6 +98,177 @@ static char* test_solving_6x4() {
     return 0;
 }
 
+/* Solve with proof-number search. */
+static char* test_pns_4x4() {
+    new_board(4, 4);
+    mu_assert("PNS 4x4 broken.", pns_solve(&board, 64) == DRAW);
+    return 0;
+}
+static char* test_pns_6x4_bug() {
+    new_board(6, 4);
+    complex_move(&board, "23");
+    mu_assert("PNS 6x4-23 broken.", pns_solve(&board, 256) == LOSE);
+    return 0;
+}
+
+/* Keep the hash between searches. */
+static char* test_keep_hash() {
+    unsigned long steps;
+    new_board(5, 4);
+    keep_hash(1);
+    mu_assert("Keep hash 1 broken.", solve(&board) == DRAW);
+    steps = ai_steps();
+    mu_assert("Keep hash 2 broken.", solve(&board) == DRAW);
+    keep_hash(0);
+    mu_assert("Keep hash 3 broken.", ai_steps() < steps);
+    return 0;
+}
+
+/* Resume a solve from a checkpoint. */
+/* Overwrites the byte at offset of file. */
+static void patch_file(const char *file, long offset, int byte) {
+    FILE *f = fopen(file, "r+b");
+    fseek(f, offset, SEEK_SET);
+    fputc(byte, f);
+    fclose(f);
+}
+
+static char* test_checkpoint() {
+    root_progress progress;
+    search_board sb;
+    board_state res;
+    unsigned long steps, column;
+    int ok;
+    new_board(5, 4);
+    complex_move(&board, "22");
+
+    /* A proven root move keeps its value and node count. */
+    init_ai(&board);
+    init_root_progress(&progress);
+    progress.value[2] = progress.res = DRAW;
+    progress.nodes[2] = 108;
+    init_search_board(&sb, &board);
+    mu_assert("Proven root move broken.",
+              search_root(&sb, &progress) == DRAW &&
+              progress.value[2] == DRAW && progress.nodes[2] == 108 &&
+              progress.nodes[1] > 0);
+
+    init_ai(&board);
+    init_root_progress(&progress);
+    init_search_board(&sb, &board);
+    search_root(&sb, &progress);
+    steps  = ai_steps();
+    column = progress.nodes[2];
+
+    /* Resuming must skip column 2, which takes most of the steps. Start with
+     * an empty hash, like the solve above. */
+    init_ai(&board);
+    init_root_progress(&progress);
+    progress.value[2] = progress.res = DRAW;
+    mu_assert("Checkpoint save broken.",
+              save_checkpoint("test.checkpoint", &board, &progress) == 0);
+    res = resume_solve("test.checkpoint");
+    remove("test.checkpoint");
+    mu_assert("Checkpoint resume broken.",
+              res == DRAW && column > steps / 2 &&
+              ai_steps() < steps - column / 2);
+
+    /* Foreign sizes and impossible moves are rejected before replaying. The
+     * header starts after the 4 byte magic, the moves after the header. */
+    save_checkpoint("test.checkpoint", &board, &progress);
+    patch_file("test.checkpoint", 4 + 4, 40);
+    ok = resume_solve("test.checkpoint") == UNKNOWN;
+    save_checkpoint("test.checkpoint", &board, &progress);
+    patch_file("test.checkpoint", 4 + 16 + 1, 9);
+    ok &= resume_solve("test.checkpoint") == UNKNOWN;
+    remove("test.checkpoint");
+    mu_assert("Checkpoint check broken.", ok);
+    return 0;
+}
+
+/* Round-trip parameters and solve with unusual ones. */
+static char* test_params() {
+    board_size a = {5, 4}, b = {6, 5};
+    solver_params p, q;
+    default_params(&p);
+    p.hash_size = 1000;
+    p.use_symmetry = 0;
+    p.reorder_depth = 3;
+    p.deep_hash_ply = 12;
+    p.killer_depth = 0;
+    p.countermove_depth = 0;
+    default_params(&q);
+    remove("test.conf");
+    mu_assert("Params save broken.",
+              save_params("test.conf", &b, &q) == 0 &&
+              save_params("test.conf", &a, &p) == 0);
+    default_params(&q);
+    mu_assert("Params load broken.", load_params("test.conf", &a, &q) == 1);
+    remove("test.conf");
+    mu_assert("Params round-trip broken.",
+              q.hash_size == 1000 && q.use_symmetry == 0 &&
+              q.reorder_depth == 3 && q.deep_hash_ply == 12 &&
+              q.killer_depth == 0 && q.countermove_depth == 0);
+    fix_params(&p);
+    new_board(5, 4);
+    mu_assert("Solving 5x4 with small hash broken.", solve(&board) == DRAW);
+    fix_params(NULL);
+    return 0;
+}
+
+/* Solve whole corpus positions with the endgame solver alone. */
+static char* test_endgame() {
+    corpus_stats stats;
+    solver_params p;
+    default_params(&p);
+    p.endgame_empty = MAX_TURNS;
+    fix_params(&p);
+    mu_assert("Endgame corpus 5x4 broken.",
+              replay_corpus("corpus/5x4.txt", NULL, &stats) == 0);
+    new_board(6, 4);
+    complex_move(&board, "23");
+    mu_assert("Endgame 6x4-23 broken.", solve(&board) == LOSE);
+    fix_params(NULL);
+    return 0;
+}
+
+/* Solve with most boards in a tiny deep hash. */
+static char* test_deep_hash() {
+    corpus_stats stats;
+    solver_params p;
+    default_params(&p);
+    p.deep_hash_ply  = 6;
+    p.deep_hash_size = 64;
+    fix_params(&p);
+    mu_assert("Deep hash corpus 5x4 broken.",
+              replay_corpus("corpus/5x4.txt", NULL, &stats) == 0);
+    new_board(6, 4);
+    complex_move(&board, "23");
+    mu_assert("Deep hash 6x4-23 broken.", solve(&board) == LOSE);
+    fix_params(NULL);
+    return 0;
+}
+
+/* Solve with killers and countermoves tried at every depth. */
+static char* test_countermoves() {
+    solver_params p;
+    default_params(&p);
+    p.killer_depth      = 0;
+    p.countermove_depth = 0;
+    fix_params(&p);
+    {
+        new_board(5, 4);
+        mu_assert("Countermoves 5x4 broken.", solve(&board) == DRAW);
+    }
+    {
+        new_board(6, 4);
+        complex_move(&board, "23");
+        mu_assert("Countermoves 6x4-23 broken.", solve(&board) == LOSE);
+    }
+    fix_params(NULL);
+    return 0;
+}
+
 /* Find a specific bug. */
 static char* test_solving_6x4_bug() {
     new_board(6, 4);
@@ -94,18 +277,313 @@ static char* test_solving_6x4_bug() {
     return 0;
 }
 
+/* Analyze all columns and check them with minimax. */
+static char* test_analyze_5x4() {
+    board_state values[MAX_COLS], expected;
+    int i;
+    new_board(5, 4);
+    complex_move(&board, "242031");
+    analyze(&board, values);
+    for (i = 0; i < size.x; i++) {
+        move(&board, i);
+        expected = has_won(&board, board.player^1) ? WIN : -minimax(&board);
+        undo(&board, 1);
+        mu_assert("Analyzing 5x4 broken.", values[i] == expected);
+    }
+    return 0;
+}
+
+/* Every win found by threats must be a win according to minimax. */
+static char* test_tss_5x4() {
+    search_board sb;
+    uint64_t state = 108;
+    int i, col, hits = 0, ok = 1;
+    new_board(5, 4);
+    init_tss(&size);
+    for (i = 0; i < 200; i++) {
+        if (!random_position(&board, 8 + i % 6, &state)) {
+            continue;
+        }
+        init_search_board(&sb, &board);
+        if (!threat_search(&sb, TSS_DEPTH, &col)) {
+            continue;
+        }
+        hits += 1;
+        move(&board, col);
+        ok &= has_won(&board, board.player^1) || minimax(&board) == LOSE;
+    }
+    mu_assert("Threat search 5x4 broken.", ok && hits > 0);
+    return 0;
+}
+
+/* The masks of winning fields must agree with trial moves, also after moves
+ * were made and unmade. */
+static char* test_threat_masks() {
+    search_board sb;
+    uint64_t state = 108;
+    players p;
+    int i, col, won, ok = 1;
+    new_board(5, 4);
+    for (i = 0; i < 200; i++) {
+        if (!random_position(&board, i % 18, &state)) {
+            continue;
+        }
+        init_search_board(&sb, &board);
+        if (search_column_free(&sb, i % sb.x)) {
+            search_move(&sb, i % sb.x);
+            search_undo(&sb, i % sb.x);
+        }
+        for (col = 0; col < sb.x; col++) {
+            for (p = WHITE; p <= BLACK && search_column_free(&sb, col); p++) {
+                won = bitmap_has_won(sb.bitmap[p] | search_move_bit(&sb, col),
+                                     sb.y);
+                ok &= ((search_wins(&sb, p) & search_move_bit(&sb, col)) != 0)
+                      == won;
+                ok &= search_wins_with(&sb, col, p) == won;
+            }
+        }
+    }
+    mu_assert("Threat masks 5x4 broken.", ok);
+    return 0;
+}
+
+/* Count open lines and check that dead boards are draws. */
+static char* test_dead_lines() {
+    search_board sb;
+    board_state res;
+    uint64_t state = 108;
+    int i, dead = 0, ok = 1;
+    new_board(4, 4);
+    init_eval(&size);
+    move(&board, 0);
+    init_search_board(&sb, &board);
+    mu_assert("Open lines 4x4 broken.",
+              open_lines(&sb, WHITE) == 10 && open_lines(&sb, BLACK) == 7);
+    for (i = 0; i < 300; i++) {
+        if (!random_position(&board, 6 + i % 8, &state)) {
+            continue;
+        }
+        init_search_board(&sb, &board);
+        res = line_eval(&sb);
+        ok &= (open_lines(&sb, board.player) == 0) ==
+              (res == DRAW || res == MAYBE_LOSE);
+        ok &= (open_lines(&sb, board.player^1) == 0) ==
+              (res == DRAW || res == MAYBE_WIN);
+        switch (res) {
+            case DRAW:       ok &= minimax(&board) == DRAW; dead++; break;
+            case MAYBE_LOSE: ok &= minimax(&board) <= DRAW; break;
+            case MAYBE_WIN:  ok &= minimax(&board) >= DRAW; break;
+            default:         break;
+        }
+    }
+    mu_assert("Dead lines 4x4 broken.", ok && dead > 0);
+    return 0;
+}
+
+/* Build the strong solution of 4x4 and compare it with minimax. */
+static char* test_db_4x4() {
+    solution_db *db;
+    uint64_t state = 108;
+    int i, ok = 1;
+    new_board(4, 4);
+    mu_assert("Building db 4x4 broken.", build_db(&size, "test.db") == 0);
+    db = open_db("test.db");
+    remove("test.db");
+    mu_assert("Opening db 4x4 broken.", db != NULL);
+    ok = db_lookup(db, &board) == DRAW;
+    for (i = 0; ok && i < 100; i++) {
+        if (random_position(&board, 2 + i % 13, &state)) {
+            ok = db_lookup(db, &board) == minimax(&board);
+        }
+    }
+    close_db(db);
+    mu_assert("Db 4x4 broken.", ok);
+    return 0;
+}
+
+/* Solve two sizes at once, then take both from the cache. */
+static char* test_solve_matrix() {
+    board_size from = {4, 4}, to = {5, 4};
+    matrix_result results[MATRIX_MAX_SIZES];
+    int n;
+    remove("test.results");
+    n = solve_matrix(&from, &to, 2, 64, "test.results", results);
+    mu_assert("Solve matrix broken.",
+              n == 2 && results[0].size.x == 5 && results[0].res == DRAW &&
+              results[1].size.x == 4 && results[1].res == DRAW &&
+              !results[0].cached && results[1].steps > 0);
+    n = solve_matrix(&from, &to, 2, 64, "test.results", results);
+    remove("test.results");
+    mu_assert("Solve matrix cache broken.",
+              n == 2 && results[0].cached && results[1].cached &&
+              results[0].res == DRAW && results[1].res == DRAW);
+    return 0;
+}
+
+/* Count positions. Distinct counts are from John Tromp's enumeration. */
+static char* test_perft_7x6() {
+    perft_result res;
+    new_board(7, 6);
+    perft(&board, 8, 2, 0, &res);
+    mu_assert("Perft 7x6 broken.", res.counts[6] == 117649);
+    perft(&board, 8, 2, 1, &res);
+    mu_assert("Distinct perft 7x6 broken.", res.counts[8] == 184275);
+    return 0;
+}
+
+/* Replay random positions certified by minimax. */
+static char* test_corpus_5x4() {
+    corpus_stats stats;
+    mu_assert("Corpus 5x4 unreadable.",
+              replay_corpus("corpus/5x4.txt", NULL, &stats) >= 0);
+    mu_assert("Corpus 5x4 not certified.", stats.certified > 0);
+    mu_assert("Corpus 5x4 broken.", stats.mismatches == 0);
+    return 0;
+}
+
+/* The iterative search must match the recursive one step by step, even when
+ * it yields all the time. */
+static char* test_search_stack() {
+    search_board sb;
+    search_stack st;
+    board_state expected, res;
+    unsigned long steps;
+    uint64_t state = 108;
+    int i, ok = 1;
+    new_board(5, 4);
+    for (i = 0; i < 20; i++) {
+        while (!random_position(&board, i % 8, &state))
+            ;
+        init_ai(&board);
+        init_search_board(&sb, &board);
+        expected = recursive_alpha_beta(&sb, LOSE, WIN);
+        steps    = ai_steps();
+
+        init_ai(&board);
+        init_search_board(&sb, &board);
+        init_search_stack(&st, &sb, LOSE, WIN);
+        while ((res = search_run(&st, 1 + i)) == UNKNOWN)
+            ;
+        ok &= res == expected && ai_steps() == steps;
+        ok &= search_step(&st) == res && sb.turn == board.turn;
+    }
+    mu_assert("Search stack 5x4 broken.", ok);
+    return 0;
+}
+
+/* Converting the corpus to records and back must give the same positions,
+ * also with columns above 9. */
+static char* test_records() {
+    record_reader r;
+    game_record rec;
+    search_board sb, expected;
+    board_size big = {12, 4};
+    board_state value;
+    char line[CORPUS_MAX_LINE], moves[CORPUS_MAX_LINE];
+    int cols[] = {11, 10, 0, 11};
+    int n = 0, ok = 1;
+    FILE *in, *out;
+    new_board(5, 4);
+    in  = fopen("corpus/5x4.txt", "r");
+    out = fopen("test.records", "wb");
+    mu_assert("Converting to records broken.",
+              in != NULL && out != NULL && text_to_records(in, out) == 60);
+    ok &= write_record(out, &big, cols, 4, UNKNOWN) == 0;
+    fclose(out);
+    rewind(in);
+    mu_assert("Opening records broken.", open_records("test.records", &r) == 0);
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (parse_corpus_line(line, &size, moves, &value) <= 0)
+            continue;
+        reset(&board);
+        complex_move(&board, moves);
+        init_search_board(&expected, &board);
+        ok &= next_record(&r, &rec) == 1 && rec.value == value &&
+              record_board(&rec, &sb) == 0 && memcmp(&sb, &expected,
+                                                     sizeof(sb)) == 0;
+        n++;
+    }
+    fclose(in);
+    ok &= next_record(&r, &rec) == 1 && rec.size.x == 12 &&
+          record_board(&rec, &sb) == 0 && sb.turn == 4 &&
+          record_move(&rec, 1) == 10 && next_record(&r, &rec) == 0;
+    close_records(&r);
+    mu_assert("Reading records broken.", ok && n == 60);
+    out = fopen("test.corpus", "w");
+    ok = records_to_text("test.records", out) == 61;
+    fclose(out);
+    in = fopen("test.corpus", "r");
+    while (fgets(line, sizeof(line), in) != NULL)
+        ;
+    fclose(in);
+    mu_assert("Converting to text broken.",
+              ok && strcmp(line, "12x4 ba0b ?\n") == 0);
+    remove("test.records");
+    remove("test.corpus");
+    return 0;
+}
+
+/* Young brothers wait must agree with alpha_beta() and, on a single thread,
+ * take exactly the same steps. */
+static char* test_ybw() {
+    search_board sb;
+    board_state expected;
+    unsigned long steps;
+    uint64_t state = 108;
+    int i, ok = 1;
+    new_board(5, 4);
+    for (i = 0; i < 10; i++) {
+        while (!random_position(&board, i % 6, &state))
+            ;
+        init_ai(&board);
+        init_search_board(&sb, &board);
+        expected = alpha_beta(&sb, LOSE, WIN);
+        steps    = ai_steps();
+        ok &= ybw_solve(&board, 1) == expected && ybw_steps() == steps;
+        ok &= ybw_solve(&board, 2 + i % 3) == expected;
+    }
+    mu_assert("YBW 5x4 broken.", ok);
+    destroy_board(&board);
+    size.x = 6;
+    init_board(&board, &size);
+    complex_move(&board, "23");
+    mu_assert("YBW 6x4-23 broken.", ybw_solve(&board, 4) == LOSE);
+    return 0;
+}
+
 /* Run all tests. */
 static char* all_tests() {
     mu_run_test(test_winning_1);
     mu_run_test(test_winning_3);
     mu_run_test(test_losing_1);
 
+    mu_run_test(test_perft_7x6);
+    mu_run_test(test_corpus_5x4);
+    mu_run_test(test_records);
+    mu_run_test(test_search_stack);
+    mu_run_test(test_analyze_5x4);
+    mu_run_test(test_tss_5x4);
+    mu_run_test(test_threat_masks);
+    mu_run_test(test_dead_lines);
+    mu_run_test(test_db_4x4);
+    mu_run_test(test_solve_matrix);
+
     mu_run_test(test_solving_4x4);
     mu_run_test(test_solving_4x5);
     mu_run_test(test_solving_5x4);
     mu_run_test(test_solving_5x5);
 
     mu_run_test(test_solving_6x4_bug);
+    mu_run_test(test_keep_hash);
+    mu_run_test(test_checkpoint);
+    mu_run_test(test_params);
+    mu_run_test(test_endgame);
+    mu_run_test(test_deep_hash);
+    mu_run_test(test_countermoves);
+    mu_run_test(test_ybw);
+
+    mu_run_test(test_pns_4x4);
+    mu_run_test(test_pns_6x4_bug);
 
     mu_run_test(test_solving_6x4);
     mu_run_test(test_solving_4x6);
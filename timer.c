@@ -0,0 +1,17 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for clock_gettime() */
+
+#include <time.h>
+#include "timer.h"
+
+/* Returns monotonic wall clock time in seconds. */
+double get_time()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
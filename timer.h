@@ -0,0 +1,10 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_TIMER_H
+#define YONMOKUNARABE_TIMER_H
+
+double get_time();
+
+#endif /* end of include guard: YONMOKUNARABE_TIMER_H */
@@ -0,0 +1,63 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Binary search traces. A trace file starts with TRACE_MAGIC, the version and
+ * the record size (uint32_t each), followed by trace_records in native byte
+ * order. Records are written in post-order, so the children of a board come
+ * before it. Use tracestat to read them.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "trace.h"
+
+static FILE *trace_out = NULL; /* Where to write records, NULL if off. */
+static int depth       = 0;    /* Trace boards before that turn. */
+
+static trace_record buffer[TRACE_BUFFER];
+static unsigned int used = 0; /* Records in the buffer. */
+
+/* Traces all boards before turn depth into out from now on. Pass NULL to
+ * stop. Returns 0 on success, -1 if the header couldn't be written. */
+int set_trace(FILE *out, int d)
+{
+    uint32_t version = TRACE_VERSION, size = sizeof(trace_record);
+
+    trace_flush();
+    trace_out = out;
+    depth     = out != NULL ? d : 0;
+    if (out == NULL) {
+        return 0;
+    }
+    if (fwrite(TRACE_MAGIC, 4, 1, out) != 1 ||
+        fwrite(&version, sizeof(version), 1, out) != 1 ||
+        fwrite(&size, sizeof(size), 1, out) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Returns the turn up to which boards are traced, 0 if tracing is off. */
+int trace_depth()
+{
+    return depth;
+}
+
+/* Adds rec to the trace. */
+void trace_write(trace_record *rec)
+{
+    buffer[used++] = *rec;
+    if (used == TRACE_BUFFER) {
+        trace_flush();
+    }
+}
+
+/* Writes all buffered records. */
+void trace_flush()
+{
+    if (trace_out != NULL && used > 0) {
+        fwrite(buffer, sizeof(trace_record), used, trace_out);
+        fflush(trace_out);
+    }
+    used = 0;
+}
@@ -0,0 +1,34 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_TRACE_H
+#define YONMOKUNARABE_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC "YMKT"
+#define TRACE_VERSION 1
+#define TRACE_DEPTH 12      /* Default: only trace boards before that turn. */
+#define TRACE_BUFFER 65536  /* Records kept in memory before writing them. */
+
+/* One searched board, written when its search is done. */
+typedef struct {
+    uint64_t nodes;   /* alpha-beta steps in the subtree, including this one */
+    uint8_t  ply;     /* turn of the board */
+    int8_t   move;    /* best or cut-off move, -1 if none was searched */
+    int8_t   alpha;   /* window on entry */
+    int8_t   beta;
+    int8_t   hash;    /* hash result, UNKNOWN if none */
+    int8_t   res;     /* returned value */
+    int8_t   cutoff;  /* index of the move that caused a cut-off, -1 if none */
+    int8_t   tried;   /* moves searched */
+} trace_record;
+
+int set_trace(FILE *out, int depth);
+int trace_depth();
+void trace_write(trace_record *rec);
+void trace_flush();
+
+#endif /* end of include guard: YONMOKUNARABE_TRACE_H */
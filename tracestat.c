@@ -0,0 +1,148 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Summarizes a search trace written by yonmokunarabe --trace:
+ *
+ *     ./tracestat FILE
+ *
+ * For each ply it reports how many boards were searched, how big their
+ * subtrees were and how good the move ordering was, i.e. how often the first
+ * move tried already caused the cut-off.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ai.h"
+#include "trace.h"
+
+#define MAX_PLY 64
+#define SIZE_BUCKETS 40 /* subtree sizes by powers of 2 */
+
+typedef struct {
+    unsigned long boards;  /* boards searched */
+    unsigned long hashed;  /* boards the hash decided without any move */
+    unsigned long cutoffs; /* boards with a cut-off */
+    unsigned long first;   /* cut-offs by the first move tried */
+    unsigned long tried;   /* moves tried in all boards */
+    unsigned long cut_at[MAX_COLS]; /* cut-offs by the nth move tried */
+    uint64_t nodes;        /* steps in all subtrees */
+    uint64_t max_nodes;    /* steps in the largest subtree */
+} ply_stats;
+
+static ply_stats plies[MAX_PLY];
+static unsigned long sizes[SIZE_BUCKETS];
+
+/* Returns the bucket of a subtree of n nodes. */
+static int bucket(uint64_t n)
+{
+    int b = 0;
+
+    while (n > 1 && b < SIZE_BUCKETS - 1) {
+        n >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/* Adds rec to the stats. */
+static void add_record(trace_record *rec)
+{
+    ply_stats *p = &plies[rec->ply % MAX_PLY];
+
+    p->boards += 1;
+    p->nodes  += rec->nodes;
+    p->tried  += rec->tried;
+    if (rec->nodes > p->max_nodes) {
+        p->max_nodes = rec->nodes;
+    }
+    if (rec->tried == 0 && rec->hash != UNKNOWN) {
+        p->hashed += 1;
+    }
+    if (rec->cutoff >= 0) {
+        p->cutoffs += 1;
+        p->first   += rec->cutoff == 0;
+        p->cut_at[rec->cutoff % MAX_COLS] += 1;
+    }
+    sizes[bucket(rec->nodes)] += 1;
+}
+
+/* Prints the reports. */
+static void print_stats()
+{
+    unsigned long cutoffs = 0, first = 0, cut_at[MAX_COLS];
+    int i, j, last = 0;
+    ply_stats *p;
+
+    printf("ply      boards    avg nodes    max nodes  hashed  moves  cuts  "
+           "1st cut\n");
+    memset(cut_at, 0, sizeof(cut_at));
+    for (i = 0; i < MAX_PLY; i++) {
+        p = &plies[i];
+        if (p->boards == 0)
+            continue;
+        printf("%3d %11lu %12.1f %12lu %6.1f%% %6.2f %4.1f%% %7.1f%%\n",
+               i, p->boards, (double) p->nodes / p->boards,
+               (unsigned long) p->max_nodes,
+               100.0 * p->hashed / p->boards,
+               (double) p->tried / p->boards,
+               100.0 * p->cutoffs / p->boards,
+               p->cutoffs ? 100.0 * p->first / p->cutoffs : 0.0);
+        cutoffs += p->cutoffs;
+        first   += p->first;
+        for (j = 0; j < MAX_COLS; j++) {
+            cut_at[j] += p->cut_at[j];
+        }
+    }
+
+    printf("\nCut-offs: %lu, by the first move: %.1f%%.\n", cutoffs,
+           cutoffs ? 100.0 * first / cutoffs : 0.0);
+    printf("Cut-offs by the nth move tried:");
+    for (j = 0; j < MAX_COLS; j++) {
+        if (cut_at[j] > 0)
+            last = j;
+    }
+    for (j = 0; j <= last; j++) {
+        printf(" %d: %.1f%%", j + 1,
+               cutoffs ? 100.0 * cut_at[j] / cutoffs : 0.0);
+    }
+
+    printf("\n\nSubtree sizes:\n");
+    for (j = 0; j < SIZE_BUCKETS; j++) {
+        if (sizes[j] > 0) {
+            printf("  %12lu - %12lu: %lu\n", 1UL << j, (2UL << j) - 1,
+                   sizes[j]);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in;
+    char magic[4];
+    uint32_t version, size;
+    trace_record rec;
+
+    if (argc != 2) {
+        printf("usage: tracestat FILE\n");
+        return 1;
+    }
+    if ((in = fopen(argv[1], "rb")) == NULL) {
+        printf("Can't open trace %s.\n", argv[1]);
+        return 1;
+    }
+    if (fread(magic, 4, 1, in) != 1 || memcmp(magic, TRACE_MAGIC, 4) != 0 ||
+        fread(&version, sizeof(version), 1, in) != 1 ||
+        fread(&size, sizeof(size), 1, in) != 1 ||
+        version != TRACE_VERSION || size != sizeof(trace_record)) {
+        printf("%s is no trace of this version.\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+    while (fread(&rec, sizeof(rec), 1, in) == 1) {
+        add_record(&rec);
+    }
+    fclose(in);
+    print_stats();
+    return 0;
+}
@@ -0,0 +1,105 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Threat-space search. The player to move only tries moves that create an
+ * immediate threat, so the opponent has exactly one reply: block it. Two
+ * threats at once can't both be blocked and win. This proves long forced
+ * sequences in a few hundred nodes where alpha_beta() has to brute-force
+ * every quiet reply. It can only ever prove a win; failing proves nothing.
+ */
+
+#include <stdio.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "tss.h"
+
+static unsigned long tss_counter  = 0; /* How many nodes were searched? */
+static unsigned long tss_calls    = 0; /* How many boards were tried? */
+static unsigned long tss_hits     = 0; /* How many of them were won? */
+
+/* Prepares masks for boards of the given size. */
+void init_tss(board_size *size)
+{
+    init_masks(size);
+    tss_counter = tss_calls = tss_hits = 0;
+}
+
+/* Returns 1 if own, the player to move, wins by threats alone within depth
+ * own moves, 0 if that is unknown. Stores the first move in *first. */
+static int tss(uint64_t own, uint64_t opp, int depth, int *first)
+{
+    uint64_t mask, possible, threats, next, wins, m;
+    unsigned int i;
+
+    tss_counter += 1;
+
+    mask     = own | opp;
+    possible = (mask + masks.bottom) & masks.board;
+    if ((m = bitmap_winning_fields(own, masks.y) & possible) != 0) {
+        for (i = 0; (m & masks.cols[i]) == 0; i++)
+            ;
+        *first = masks.col_index[i];
+        return 1;
+    }
+    if (depth <= 0) {
+        return 0;
+    }
+
+    threats = bitmap_winning_fields(opp, masks.y) & masks.board;
+    if (threats & possible) {
+        possible &= threats;
+        if (possible & (possible - 1)) {
+            return 0; /* More than 1 threat. */
+        }
+    }
+    /* Don't play right below a field the opponent needs. */
+    possible &= ~(threats >> 1);
+
+    for (i = 0; possible != 0 && i < masks.x; i++) {
+        if ((m = possible & masks.cols[i]) == 0) {
+            continue;
+        }
+        possible ^= m;
+        next = ((mask | m) + masks.bottom) & masks.board;
+        wins = bitmap_winning_fields(own | m, masks.y) & next;
+        if (wins == 0) {
+            continue; /* Not a threat, the opponent could play anything. */
+        }
+        if (wins & (wins - 1)) {
+            *first = masks.col_index[i];
+            return 1; /* Can't block both. */
+        }
+        /* The block must not win for the opponent. */
+        if (bitmap_has_won(opp | wins, masks.y)) {
+            continue;
+        }
+        if (tss(own | m, opp | wins, depth - 1, first)) {
+            *first = masks.col_index[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Tries to prove a win for the player to move within depth own moves. Returns
+ * 1 and stores the winning column in *col on success, 0 otherwise. */
+int threat_search(search_board *sb, int depth, int *col)
+{
+    int first = -1;
+
+    tss_calls += 1;
+    if (!tss(sb->bitmap[sb->player], sb->bitmap[sb->player^1], depth, &first)) {
+        return 0;
+    }
+    tss_hits += 1;
+    *col = first;
+    return 1;
+}
+
+/* Prints threat-space search stats. */
+void print_tss_stats()
+{
+    printf("Threat search: %lu of %lu boards won, %lu nodes.\n",
+           tss_hits, tss_calls, tss_counter);
+}
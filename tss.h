@@ -0,0 +1,17 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_TSS_H
+#define YONMOKUNARABE_TSS_H
+
+#include "board.h"
+
+#define USE_TSS   1  /* try threat-space search before recommend_move() */
+#define TSS_DEPTH 10 /* own moves in a threat sequence, at most */
+
+void init_tss(board_size *size);
+int threat_search(search_board *sb, int depth, int *col);
+void print_tss_stats();
+
+#endif /* end of include guard: YONMOKUNARABE_TSS_H */
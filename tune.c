@@ -0,0 +1,182 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Tunes the solver parameters by replaying a corpus. For each board size in
+ * the corpus, one parameter after the other is set to each of its candidate
+ * values while the others stay fixed (coordinate descent), keeping whatever
+ * replays fastest. Candidates that get a certified position wrong are
+ * rejected outright.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "board.h"
+#include "corpus.h"
+#include "params.h"
+#include "tune.h"
+
+enum { PARAM_HASH_SIZE, PARAM_HASH_CUT_OFF, PARAM_REORDER_DEPTH,
+       PARAM_USE_SYMMETRY, PARAM_SYMMETRY_CUT_OFF, PARAM_ENDGAME_EMPTY,
+       PARAM_DEEP_HASH_PLY, PARAM_KILLER_DEPTH, PARAM_COUNTERMOVE_DEPTH,
+       PARAM_COUNT };
+
+static const char *param_names[PARAM_COUNT] = {
+    "hash_size", "hash_cut_off", "reorder_depth", "use_symmetry",
+    "symmetry_cut_off", "endgame_empty", "deep_hash_ply", "killer_depth",
+    "countermove_depth"
+};
+
+/* Candidate values, terminated by CANDIDATES_END. */
+#define CANDIDATES_END -1000
+static const long candidates[PARAM_COUNT][8] = {
+    { HASHSIZE/16, HASHSIZE/4, HASHSIZE, 2*HASHSIZE, CANDIDATES_END },
+    { -1, 20, 30, CANDIDATES_END },
+    { 0, 5, 10, 20, CANDIDATES_END },
+    { 0, 1, CANDIDATES_END },
+    { 10, 20, -1, CANDIDATES_END },
+    { 0, 6, 8, 10, 12, CANDIDATES_END },
+    { -1, 12, 16, 20, 24, CANDIDATES_END },
+    { -1, 0, 8, 10, 12, 16, CANDIDATES_END },
+    { -1, 0, 8, 10, 12, 16, CANDIDATES_END }
+};
+
+/* Sets parameter i of p to value. */
+static void set_param(solver_params *p, int i, long value)
+{
+    switch (i) {
+        case PARAM_HASH_SIZE:        p->hash_size         = value; break;
+        case PARAM_HASH_CUT_OFF:     p->hash_cut_off      = value; break;
+        case PARAM_REORDER_DEPTH:    p->reorder_depth     = value; break;
+        case PARAM_USE_SYMMETRY:     p->use_symmetry      = value; break;
+        case PARAM_SYMMETRY_CUT_OFF: p->symmetry_cut_off  = value; break;
+        case PARAM_ENDGAME_EMPTY:    p->endgame_empty     = value; break;
+        case PARAM_DEEP_HASH_PLY:    p->deep_hash_ply     = value; break;
+        case PARAM_KILLER_DEPTH:     p->killer_depth      = value; break;
+        case PARAM_COUNTERMOVE_DEPTH:p->countermove_depth = value; break;
+    }
+}
+
+/* Returns parameter i of p. */
+static long get_param(solver_params *p, int i)
+{
+    switch (i) {
+        case PARAM_HASH_SIZE:        return p->hash_size;
+        case PARAM_HASH_CUT_OFF:     return p->hash_cut_off;
+        case PARAM_REORDER_DEPTH:    return p->reorder_depth;
+        case PARAM_USE_SYMMETRY:     return p->use_symmetry;
+        case PARAM_SYMMETRY_CUT_OFF: return p->symmetry_cut_off;
+        case PARAM_ENDGAME_EMPTY:    return p->endgame_empty;
+        case PARAM_DEEP_HASH_PLY:    return p->deep_hash_ply;
+        case PARAM_KILLER_DEPTH:     return p->killer_depth;
+        case PARAM_COUNTERMOVE_DEPTH:return p->countermove_depth;
+    }
+    return CANDIDATES_END;
+}
+
+/* Replays all positions of size in corpus with p. Returns the fastest time of
+ * TUNE_RUNS replays or -1 if p got any position wrong. */
+static double measure(const char *corpus, board_size *size, solver_params *p)
+{
+    corpus_stats stats;
+    double best = -1;
+    int run;
+
+    fix_params(p);
+    for (run = 0; run < TUNE_RUNS; run++) {
+        if (replay_corpus(corpus, size, &stats) != 0) {
+            return -1;
+        }
+        if (best < 0 || stats.time < best) {
+            best = stats.time;
+        }
+    }
+    return best;
+}
+
+/* Collects the distinct board sizes of corpus into sizes. Returns their
+ * number or -1 if the corpus can't be read. */
+static int corpus_sizes(const char *corpus, board_size *sizes)
+{
+    FILE *in;
+    char line[CORPUS_MAX_LINE];
+    board_size size;
+    int i, n = 0;
+
+    if ((in = fopen(corpus, "r")) == NULL) {
+        printf("Can't open corpus %s.\n", corpus);
+        return -1;
+    }
+    while (n < TUNE_MAX_SIZES && fgets(line, sizeof(line), in) != NULL) {
+        if (line[0] == '#' ||
+            sscanf(line, "%ux%u", &size.x, &size.y) != 2) {
+            continue;
+        }
+        for (i = 0; i < n; i++) {
+            if (sizes[i].x == size.x && sizes[i].y == size.y)
+                break;
+        }
+        if (i == n) {
+            sizes[n++] = size;
+        }
+    }
+    fclose(in);
+    return n;
+}
+
+/* Tunes the parameters for every board size in corpus and saves the best ones
+ * to conf. Returns 0 on success, -1 otherwise. */
+int tune_params(const char *corpus, const char *conf)
+{
+    board_size sizes[TUNE_MAX_SIZES];
+    solver_params best, p;
+    double best_time, t;
+    int n, s, pass, i, j;
+    int res = 0;
+
+    if ((n = corpus_sizes(corpus, sizes)) < 0) {
+        return -1;
+    }
+
+    for (s = 0; s < n; s++) {
+        default_params(&best);
+        if ((best_time = measure(corpus, &sizes[s], &best)) < 0) {
+            printf("%dx%d: defaults already get positions wrong, skipping.\n",
+                   sizes[s].x, sizes[s].y);
+            res = -1;
+            continue;
+        }
+        printf("%dx%d: defaults take %.3fs.\n",
+               sizes[s].x, sizes[s].y, best_time);
+
+        for (pass = 0; pass < TUNE_PASSES; pass++) {
+            for (i = 0; i < PARAM_COUNT; i++) {
+                for (j = 0; candidates[i][j] != CANDIDATES_END; j++) {
+                    if (candidates[i][j] == get_param(&best, i))
+                        continue;
+                    p = best;
+                    set_param(&p, i, candidates[i][j]);
+                    t = measure(corpus, &sizes[s], &p);
+                    printf("%dx%d: %s=%ld takes ", sizes[s].x, sizes[s].y,
+                           param_names[i], candidates[i][j]);
+                    if (t < 0) {
+                        printf("- (wrong results, rejected)\n");
+                    } else {
+                        printf("%.3fs.\n", t);
+                    }
+                    if (t >= 0 && t < best_time) {
+                        best      = p;
+                        best_time = t;
+                    }
+                }
+            }
+        }
+
+        printf("%dx%d: best %.3fs with ", sizes[s].x, sizes[s].y, best_time);
+        print_params(stdout, &best);
+        if (save_params(conf, &sizes[s], &best) < 0) {
+            res = -1;
+        }
+    }
+    fix_params(NULL);
+    return res;
+}
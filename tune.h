@@ -0,0 +1,16 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_TUNE_H
+#define YONMOKUNARABE_TUNE_H
+
+#include "board.h"
+
+#define TUNE_PASSES 2   /* Sweeps over all parameters. */
+#define TUNE_RUNS 3     /* Replays per candidate, the fastest one counts. */
+#define TUNE_MAX_SIZES 16
+
+int tune_params(const char *corpus, const char *conf);
+
+#endif /* end of include guard: YONMOKUNARABE_TUNE_H */
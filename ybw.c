@@ -0,0 +1,386 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ *
+ * Parallel alpha-beta with young brothers wait. The first move of a board is
+ * searched alone, like alpha_beta() would. Only then are its younger brothers
+ * handed out as tasks, so they get the window the eldest brother produced.
+ * Each thread keeps its tasks in a deque: the owner takes the newest, idle
+ * threads steal the oldest, which are the biggest. A cut-off cancels all
+ * tasks below the board it happened on. The hash is shared by all threads,
+ * move order tables and counters are kept per thread.
+ */
+
+#define _POSIX_C_SOURCE 200112L /* for sysconf() and sched_yield() */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ai.h"
+#include "board.h"
+#include "common.h"
+#include "endgame.h"
+#include "eval.h"
+#include "hash.h"
+#include "timer.h"
+#include "ybw.h"
+
+/* A board whose younger brothers are searched in parallel. */
+typedef struct ybw_split {
+    struct ybw_split *parent; /* split point above, NULL at the root */
+    search_board sb;          /* the board itself, read-only once split */
+    search_frame f;           /* its frame, guarded by lock */
+    int pending;              /* tasks not finished yet, guarded by lock */
+    int cut;                  /* set on a cut-off, cancels all tasks below,
+                                 read without lock, see cancelled() */
+    pthread_mutex_t lock;
+} ybw_split;
+
+/* A single move of a split point. */
+typedef struct {
+    ybw_split *sp;
+    int col;
+} ybw_task;
+
+struct ybw_shared;
+
+typedef struct {
+    struct ybw_shared *shared;
+    pthread_t thread;
+    pthread_mutex_t lock;           /* guards the deque */
+    ybw_task deque[YBW_DEQUE_SIZE]; /* oldest task first */
+    int tasks;                      /* tasks in the deque */
+    unsigned long nodes;            /* boards entered by this thread */
+    unsigned long splits;           /* split points opened */
+    unsigned long steals;           /* tasks taken from other threads */
+    unsigned long aborted;          /* tasks cancelled by cut-offs */
+} ybw_worker;
+
+typedef struct ybw_shared {
+    ybw_worker *workers;
+    board_size *size;
+    int threads;
+    int split_until;                /* boards before that turn are split */
+    int done;                       /* tells idle threads to stop, atomic */
+} ybw_shared;
+
+static unsigned long ybw_counter = 0; /* Steps of the last ybw_solve(). */
+
+static board_state ybw_node(ybw_worker *w, search_board *sb,
+                            board_state alpha, board_state beta,
+                            ybw_split *parent);
+
+/* Was there a cut-off at sp or any split point above it? Flags are read
+ * atomically but without locks, a late cut-off only costs some wasted work. */
+static int cancelled(ybw_split *sp)
+{
+    for (; sp != NULL; sp = sp->parent) {
+        if (__atomic_load_n(&sp->cut, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Is sp the split point top or below it? */
+static int below(ybw_split *sp, ybw_split *top)
+{
+    for (; sp != NULL; sp = sp->parent) {
+        if (sp == top) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Adds a task as the newest of w. */
+static void push_task(ybw_worker *w, ybw_split *sp, int col)
+{
+    pthread_mutex_lock(&w->lock);
+    if (w->tasks >= YBW_DEQUE_SIZE)
+        abort();
+    w->deque[w->tasks].sp  = sp;
+    w->deque[w->tasks].col = col;
+    w->tasks += 1;
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* Takes the newest task of w if it belongs to sp, or any task if sp is NULL.
+ * Returns 1 if there was one. */
+static int pop_task(ybw_worker *w, ybw_split *sp, ybw_task *t)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->tasks > 0 && (sp == NULL || w->deque[w->tasks-1].sp == sp)) {
+        w->tasks -= 1;
+        *t = w->deque[w->tasks];
+        found = 1;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return found;
+}
+
+/* Takes the oldest task of victim that lies below sp, or the oldest task at
+ * all if sp is NULL. Returns 1 if there was one. */
+static int steal_task(ybw_worker *victim, ybw_split *sp, ybw_task *t)
+{
+    int i, found = 0;
+
+    pthread_mutex_lock(&victim->lock);
+    for (i = 0; i < victim->tasks; i++) {
+        if (sp == NULL || below(victim->deque[i].sp, sp)) {
+            *t = victim->deque[i];
+            victim->tasks -= 1;
+            memmove(&victim->deque[i], &victim->deque[i+1],
+                    (victim->tasks - i) * sizeof(ybw_task));
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&victim->lock);
+    return found;
+}
+
+/* Finds a task for w. A thread waiting for its split point sp only helps
+ * below sp, so sp can't get stuck under unrelated work. */
+static int find_task(ybw_worker *w, ybw_split *sp, ybw_task *t)
+{
+    ybw_shared *shared = w->shared;
+    int i, id = w - shared->workers;
+
+    if (pop_task(w, sp, t)) {
+        return 1;
+    }
+    for (i = 1; i < shared->threads; i++) {
+        if (steal_task(&shared->workers[(id + i) % shared->threads], sp, t)) {
+            w->steals += 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Searches a single move of a split point and hands its value over. */
+static void run_task(ybw_worker *w, ybw_task *t)
+{
+    ybw_split *sp = t->sp;
+    search_board sb = sp->sb;
+    board_state alpha, beta;
+    board_state temp = UNKNOWN;
+
+    if (!cancelled(sp)) {
+        /* Use the best window known by now. */
+        pthread_mutex_lock(&sp->lock);
+        alpha = sp->f.alpha;
+        beta  = sp->f.beta;
+        pthread_mutex_unlock(&sp->lock);
+        search_move(&sb, t->col);
+        temp = ybw_node(w, &sb, -beta, -alpha, sp);
+    }
+
+    pthread_mutex_lock(&sp->lock);
+    if (temp != UNKNOWN && !sp->cut) {
+        sp->f.col = t->col;
+        if (search_take(&sp->sb, &sp->f, -temp)) {
+            __atomic_store_n(&sp->cut, 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        w->aborted += 1;
+    }
+    sp->pending -= 1;
+    pthread_mutex_unlock(&sp->lock);
+}
+
+/* Searches sb alone with alpha_beta()'s engine, a chunk at a time. Returns
+ * UNKNOWN if a cut-off above made the result useless. */
+static board_state ybw_leaf(ybw_worker *w, search_board *sb,
+                            board_state alpha, board_state beta,
+                            ybw_split *parent)
+{
+    search_stack st;
+    search_board b = *sb; /* left half-searched if cancelled */
+    board_state res;
+
+    init_search_stack(&st, &b, alpha, beta);
+    while ((res = search_run(&st, YBW_CHUNK)) == UNKNOWN) {
+        if (cancelled(parent)) {
+            break;
+        }
+    }
+    w->nodes += st.steps;
+    return res;
+}
+
+/* Searches sb, splitting it after its first move. Returns UNKNOWN if a
+ * cut-off above made the result useless. */
+static board_state ybw_node(ybw_worker *w, search_board *sb,
+                            board_state alpha, board_state beta,
+                            ybw_split *parent)
+{
+    ybw_split sp;
+    ybw_task t;
+    board_state temp;
+    int moves[MAX_COLS];
+    int col, i, n = 0, pending;
+
+    if (sb->turn >= w->shared->split_until) {
+        return ybw_leaf(w, sb, alpha, beta, parent);
+    }
+
+    w->nodes  += 1;
+    sp.f.alpha = alpha;
+    sp.f.beta  = beta;
+    if ((col = search_enter(sb, &sp.f)) < 0) {
+        return sp.f.res;
+    }
+
+    /* The eldest brother goes first, alone. */
+    sp.f.col = col;
+    search_move(sb, col);
+    temp = ybw_node(w, sb, -sp.f.beta, -sp.f.alpha, parent);
+    search_undo(sb, col);
+    if (temp == UNKNOWN) {
+        return UNKNOWN;
+    }
+    if ((col = search_leave(sb, &sp.f, -temp)) < 0) {
+        return sp.f.res;
+    }
+
+    /* Then the younger ones, in parallel. The owner takes the newest task
+     * first, so they are pushed in reverse and alone it searches them in the
+     * same order alpha_beta() does. */
+    do {
+        moves[n++] = col;
+    } while ((col = search_next(sb, &sp.f)) >= 0);
+    sp.parent  = parent;
+    sp.sb      = *sb;
+    sp.pending = n;
+    sp.cut     = 0;
+    pthread_mutex_init(&sp.lock, NULL);
+    w->splits += 1;
+    for (i = n - 1; i >= 0; i--) {
+        push_task(w, &sp, moves[i]);
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&sp.lock);
+        pending = sp.pending;
+        pthread_mutex_unlock(&sp.lock);
+        if (pending == 0) {
+            break;
+        }
+        if (find_task(w, &sp, &t)) {
+            run_task(w, &t);
+        } else {
+            sched_yield();
+        }
+    }
+    pthread_mutex_destroy(&sp.lock);
+
+    if (cancelled(parent)) {
+        return UNKNOWN;
+    }
+    search_finish(sb, &sp.f);
+    return sp.f.res;
+}
+
+/* Idle threads steal whatever they can find until the search is done. Their
+ * stats are handed over to the main thread at the end. */
+static void *ybw_thread(void *arg)
+{
+    ybw_worker *w = (ybw_worker *) arg;
+    ybw_task t;
+
+    reset_reorder(w->shared->size);
+    while (!__atomic_load_n(&w->shared->done, __ATOMIC_RELAXED)) {
+        if (find_task(w, NULL, &t)) {
+            run_task(w, &t);
+        } else {
+            sched_yield();
+        }
+    }
+    merge_hash_stats();
+    merge_eval_stats();
+    merge_endgame_stats();
+    return NULL;
+}
+
+/* Solves board with the given number of threads (0 means one per core) and
+ * prints the result like solve(). Tracing isn't supported. */
+board_state ybw_solve(board *board, int threads)
+{
+    ybw_shared shared;
+    ybw_worker *workers;
+    search_board sb;
+    board_state res;
+    unsigned long splits = 0, steals = 0, aborted = 0;
+    double start;
+    int i;
+
+    if (threads <= 0) {
+        threads = max(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    threads = min(threads, YBW_MAX_THREADS);
+
+    printf("Solving %dx%d board now (young brothers wait, %d thread(s)).\n",
+           board->size->x, board->size->y, threads);
+    print_board(board);
+    init_ai(board);
+
+    if ((workers = calloc(threads, sizeof(ybw_worker))) == NULL)
+        abort();
+    shared.workers     = workers;
+    shared.size        = board->size;
+    shared.threads     = threads;
+    shared.split_until = board->turn + YBW_SPLIT_DEPTH;
+    shared.done        = 0;
+    for (i = 0; i < threads; i++) {
+        workers[i].shared = &shared;
+        pthread_mutex_init(&workers[i].lock, NULL);
+    }
+
+    printf("Solving...\n");
+    start = get_time();
+    share_hash(threads > 1);
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, ybw_thread,
+                           &workers[i]) != 0)
+            abort();
+    }
+    init_search_board(&sb, board);
+    res = ybw_node(&workers[0], &sb, LOSE, WIN, NULL);
+    __atomic_store_n(&shared.done, 1, __ATOMIC_RELAXED);
+    for (i = 1; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    ybw_counter = 0;
+    for (i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&workers[i].lock);
+        ybw_counter += workers[i].nodes;
+        splits      += workers[i].splits;
+        steals      += workers[i].steals;
+        aborted     += workers[i].aborted;
+    }
+    share_hash(0);
+
+    printf("Done. Took %lu steps in %.3fs.\n", ybw_counter,
+           get_time() - start);
+    printf("Split points: %lu, steals: %lu, aborted tasks: %lu.\n",
+           splits, steals, aborted);
+    print_hash_stats();
+    print_eval_stats();
+    print_endgame_stats();
+    print_result(res);
+
+    free(workers);
+    return res;
+}
+
+/* Returns the steps all threads of the last ybw_solve() took together. */
+unsigned long ybw_steps()
+{
+    return ybw_counter;
+}
@@ -0,0 +1,23 @@
+/* Copyright muflax <mail@muflax.com>, 2010
+ * License: GNU GPL 3 <http://www.gnu.org/copyleft/gpl.html>
+ */
+
+#ifndef YONMOKUNARABE_YBW_H
+#define YONMOKUNARABE_YBW_H
+
+#include "ai.h"
+#include "board.h"
+
+#define YBW_SPLIT_DEPTH 12    /* Boards less than that many plies below the
+                                 root may be split, deeper ones are searched
+                                 by a single thread. */
+#define YBW_CHUNK 4096        /* Boards searched between checks for
+                                 cut-offs above. */
+#define YBW_MAX_THREADS 64
+#define YBW_DEQUE_SIZE (YBW_SPLIT_DEPTH * MAX_COLS) /* Enough for one open
+                                                       split point per ply. */
+
+board_state ybw_solve(board *board, int threads);
+unsigned long ybw_steps();
+
+#endif /* end of include guard: YONMOKUNARABE_YBW_H */
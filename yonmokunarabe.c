@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #ifdef __GNU_LIBRARY__
 #include <getopt.h> /* for long options */
 #else
@@ -13,7 +14,19 @@
 #endif
 #include "ai.h"
 #include "board.h"
+#include "checkpoint.h"
 #include "common.h"
+#include "corpus.h"
+#include "db.h"
+#include "hash.h"
+#include "matrix.h"
+#include "params.h"
+#include "perft.h"
+#include "pns.h"
+#include "record.h"
+#include "trace.h"
+#include "tune.h"
+#include "ybw.h"
 #include "yonmokunarabe.h"
 
 /* Global variables. */
@@ -26,10 +39,56 @@ void usage()
            "options:\n"
            "\t-h --help             print help (this text)\n"
            "\t-v --verbose          be verbose\n"
+           "\t-j --threads N        use N threads (default: one per core)\n"
+           "\t                      solve-matrix: run N solves at once\n"
+           "\t-e --engine E         solve with engine E: ab (alpha-beta,\n"
+           "\t                      default), pns (proof-number search)\n"
+           "\t                      or ybw (parallel alpha-beta)\n"
+           "\t-m --memory MB        pns: size of the node pool (default 512)\n"
+           "\t                      solve-matrix: hash memory of all solves\n"
+           "\t                      together (default 1024)\n"
+           "\t-k --keep-hash        keep hash entries between searches of\n"
+           "\t                      boards of the same size\n"
+           "\t-c --checkpoint FILE  solve: save progress to FILE regularly\n"
+           "\t-E --every SECONDS    seconds between checkpoints (default 600)\n"
+           "\t-P --progress FILE    solve: report progress as JSON lines to\n"
+           "\t                      FILE, - for stderr\n"
+           "\t-I --interval SECONDS seconds between reports (default 10)\n"
+           "\t-t --trace FILE       solve: write a binary search trace to\n"
+           "\t                      FILE, see tracestat\n"
+           "\t-D --trace-depth N    trace boards before turn N (default 12)\n"
+           "\t-d --distinct         perft: count distinct positions only\n"
+           "\t-n --count N          generate: number of positions (default 100)\n"
+           "\t-l --plies A-B        generate: moves per position (default 4-)\n"
+           "\t-S --seed S           generate: random seed (default 108)\n"
+           "\t-o --output FILE      generate: write corpus to FILE\n"
+           "\t                      build-db: write database to FILE\n"
+           "\t                      convert: write result to FILE\n"
+           "\t                      solve-matrix: cache results in FILE\n"
+           "\t                      (default yonmokunarabe.results)\n"
+           "\t-B --db FILE          recommend: look moves up in database FILE\n"
            "modes:\n"
            "\t-s --solve WxH        solve board of size WxH and print result\n"
+           "\t-M --solve-matrix WxH..WxH\n"
+           "\t                      solve all sizes in between, several at\n"
+           "\t                      once, and print a table of the results\n"
            "\t-r --recommend WxH-M  recommend move for boardf size WxH,\n"
            "\t                      perform moves M and print result\n"
+           "\t-p --perft WxH[-M] D  count positions up to depth D on board of\n"
+           "\t                      size WxH after moves M\n"
+           "\t-a --analyze WxH-M    perform moves M on board of size WxH and\n"
+           "\t                      print the value of every column\n"
+           "\t-g --generate WxH     generate corpus of random positions\n"
+           "\t-b --bench FILE       solve all positions of corpus or record\n"
+           "\t                      FILE and check their values\n"
+           "\t-C --convert FILE     convert corpus FILE to binary game\n"
+           "\t                      records or records back to a corpus\n"
+           "\t-R --resume FILE      continue solve from checkpoint FILE\n"
+           "\t-X --build-db WxH     write the value of every position of\n"
+           "\t                      board size WxH to a database\n"
+           "\t-T --tune FILE        tune solver parameters on corpus FILE and\n"
+           "\t                      save them to yonmokunarabe.conf (or\n"
+           "\t                      $YONMOKUNARABE_CONF)\n"
            );
     exit(1);
 }
@@ -56,6 +115,36 @@ int main (int argc, char * const argv[])
     board_size size;
     board board;
     char *moves = "";
+    int threads = 0;
+    int distinct = 0;
+    int depth = 0;
+    board_state values[MAX_COLS];
+    perft_result perft_res;
+    int count = 100;
+    int min_ply = 4;
+    int max_ply = MAX_TURNS;
+    uint64_t seed = 108;
+    char *file = NULL;
+    char *input = NULL;
+    char *end;
+    FILE *in, *out;
+    long n;
+    corpus_stats stats;
+    int use_pns = 0;
+    int use_ybw = 0;
+    unsigned long memory = 0;
+    char *checkpoint = NULL;
+    double every = CHECKPOINT_EVERY;
+    char *progress = NULL;
+    double interval = PROGRESS_EVERY;
+    FILE *progress_out = NULL;
+    char *trace = NULL;
+    int trace_turns = TRACE_DEPTH;
+    FILE *trace_out = NULL;
+    char *db_file = NULL;
+    solution_db *db = NULL;
+    board_size last;
+    matrix_result results[MATRIX_MAX_SIZES];
 
 #ifdef __GNU_LIBRARY__
     int option_index;
@@ -63,13 +152,38 @@ int main (int argc, char * const argv[])
         {"verbose",      no_argument,       0, 'v'},
         {"help",         no_argument,       0, 'h'},
         {"solve",        required_argument, 0, 's'},
+        {"solve-matrix", required_argument, 0, 'M'},
         {"recommend",    required_argument, 0, 'r'},
+        {"perft",        required_argument, 0, 'p'},
+        {"analyze",      required_argument, 0, 'a'},
+        {"threads",      required_argument, 0, 'j'},
+        {"distinct",     no_argument,       0, 'd'},
+        {"generate",     required_argument, 0, 'g'},
+        {"count",        required_argument, 0, 'n'},
+        {"plies",        required_argument, 0, 'l'},
+        {"seed",         required_argument, 0, 'S'},
+        {"output",       required_argument, 0, 'o'},
+        {"bench",        required_argument, 0, 'b'},
+        {"engine",       required_argument, 0, 'e'},
+        {"memory",       required_argument, 0, 'm'},
+        {"keep-hash",    no_argument,       0, 'k'},
+        {"checkpoint",   required_argument, 0, 'c'},
+        {"every",        required_argument, 0, 'E'},
+        {"resume",       required_argument, 0, 'R'},
+        {"progress",     required_argument, 0, 'P'},
+        {"interval",     required_argument, 0, 'I'},
+        {"tune",         required_argument, 0, 'T'},
+        {"db",           required_argument, 0, 'B'},
+        {"build-db",     required_argument, 0, 'X'},
+        {"convert",      required_argument, 0, 'C'},
+        {"trace",        required_argument, 0, 't'},
+        {"trace-depth",  required_argument, 0, 'D'},
         {0, 0, 0, 0}
     };
     
-    while ((c = getopt_long(argc, argv, "hvs:r:", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "hvdkj:n:l:S:o:e:m:c:E:P:I:t:D:s:M:r:a:p:g:b:R:T:B:X:C:", long_options, &option_index)) != -1) {
 #else
-    while ((c = getopt(argc, argv, "hvs:r:")) != -1) {
+    while ((c = getopt(argc, argv, "hvdkj:n:l:S:o:e:m:c:E:P:I:t:D:s:M:r:a:p:g:b:R:T:B:X:C:")) != -1) {
 #endif     
         switch (c) {
            case 'v':
@@ -79,10 +193,110 @@ int main (int argc, char * const argv[])
              mode = MODE_SOLVE;
              parse_size(optarg, &size);
              break;
+           case 'M':
+             mode = MODE_MATRIX;
+             end = parse_size(optarg, &size);
+             if (strncmp(end, "..", 2) == 0) {
+                 parse_size(end + 2, &last);
+             } else {
+                 last = size;
+             }
+             break;
            case 'r':
              mode = MODE_RECOMMEND;
              moves = parse_size(optarg, &size) + 1;
              break;
+           case 'a':
+             mode = MODE_ANALYZE;
+             moves = parse_size(optarg, &size);
+             if (*moves != '\0')
+                 moves++;
+             break;
+           case 'p':
+             mode = MODE_PERFT;
+             moves = parse_size(optarg, &size);
+             if (*moves != '\0')
+                 moves++;
+             break;
+           case 'j':
+             threads = (int) strtol(optarg, NULL, 10);
+             break;
+           case 'd':
+             distinct = 1;
+             break;
+           case 'g':
+             mode = MODE_GENERATE;
+             parse_size(optarg, &size);
+             break;
+           case 'n':
+             count = (int) strtol(optarg, NULL, 10);
+             break;
+           case 'l':
+             min_ply = (int) strtol(optarg, &end, 10);
+             if (*end == '-' && *(end+1) != '\0')
+                 max_ply = (int) strtol(end+1, NULL, 10);
+             break;
+           case 'S':
+             seed = strtoull(optarg, NULL, 10);
+             break;
+           case 'o':
+             file = optarg;
+             break;
+           case 'b':
+             mode = MODE_BENCH;
+             file = optarg;
+             break;
+           case 'e':
+             use_pns = strcmp(optarg, "pns") == 0;
+             use_ybw = strcmp(optarg, "ybw") == 0;
+             if (!use_pns && !use_ybw && strcmp(optarg, "ab") != 0) {
+                 printf("Unknown engine %s.\n", optarg);
+                 usage();
+             }
+             break;
+           case 'm':
+             memory = strtoul(optarg, NULL, 10);
+             break;
+           case 'k':
+             keep_hash(1);
+             break;
+           case 'c':
+             checkpoint = optarg;
+             break;
+           case 'E':
+             every = strtod(optarg, NULL);
+             break;
+           case 'P':
+             progress = optarg;
+             break;
+           case 'I':
+             interval = strtod(optarg, NULL);
+             break;
+           case 't':
+             trace = optarg;
+             break;
+           case 'D':
+             trace_turns = (int) strtol(optarg, NULL, 10);
+             break;
+           case 'R':
+             mode = MODE_RESUME;
+             file = optarg;
+             break;
+           case 'T':
+             mode = MODE_TUNE;
+             file = optarg;
+             break;
+           case 'B':
+             db_file = optarg;
+             break;
+           case 'X':
+             mode = MODE_BUILD_DB;
+             parse_size(optarg, &size);
+             break;
+           case 'C':
+             mode = MODE_CONVERT;
+             input = optarg;
+             break;
            case 'h':
            case '?':
              usage();
@@ -91,6 +305,41 @@ int main (int argc, char * const argv[])
         }
     }
     
+    if (use_ybw && (checkpoint != NULL || progress != NULL ||
+                    mode == MODE_RESUME)) {
+        printf("Checkpoints and progress reports don't work with several "
+               "threads.\n");
+        return 1;
+    }
+    if (checkpoint != NULL) {
+        set_checkpoint(checkpoint, every);
+    }
+    if (progress != NULL) {
+        if (strcmp(progress, "-") == 0) {
+            progress_out = stderr;
+        } else if ((progress_out = fopen(progress, "a")) == NULL) {
+            printf("Can't write to %s.\n", progress);
+            return 1;
+        }
+        set_progress(progress_out, interval);
+    }
+    if (db_file != NULL) {
+        if ((db = open_db(db_file)) == NULL)
+            return 1;
+        set_db(db);
+    }
+    if (trace != NULL) {
+        if (use_ybw) {
+            printf("Tracing doesn't work with several threads.\n");
+            return 1;
+        }
+        if ((trace_out = fopen(trace, "wb")) == NULL ||
+            set_trace(trace_out, trace_turns) < 0) {
+            printf("Can't write to %s.\n", trace);
+            return 1;
+        }
+    }
+
     /* Start operation. */
     switch (mode) {
         case MODE_NONE:
@@ -98,17 +347,132 @@ int main (int argc, char * const argv[])
             break;
         case MODE_SOLVE:
             init_board(&board, &size);
-            solve(&board);
+            if (use_pns) {
+                pns_solve(&board, memory > 0 ? memory : PNS_MEMORY);
+            } else if (use_ybw) {
+                ybw_solve(&board, threads);
+            } else {
+                solve(&board);
+            }
             destroy_board(&board);
             break;
+        case MODE_MATRIX:
+            if ((n = solve_matrix(&size, &last, threads,
+                                  memory > 0 ? memory : MATRIX_MEMORY,
+                                  file != NULL ? file : MATRIX_CACHE,
+                                  results)) < 0)
+                return 1;
+            print_matrix(results, n);
+            while (n-- > 0) {
+                if (results[n].res == UNKNOWN)
+                    return 1;
+            }
+            break;
         case MODE_RECOMMEND:
             init_board(&board, &size);
             complex_move(&board, moves);
             recommend_move(&board);
             destroy_board(&board);
             break;
+        case MODE_ANALYZE:
+            init_board(&board, &size);
+            complex_move(&board, moves);
+            analyze(&board, values);
+            destroy_board(&board);
+            break;
+        case MODE_PERFT:
+            if (optind >= argc) {
+                printf("Perft needs a depth.\n");
+                usage();
+            }
+            depth = (int) strtol(argv[optind], NULL, 10);
+            init_board(&board, &size);
+            complex_move(&board, moves);
+            print_board(&board);
+            perft(&board, depth, threads, distinct, &perft_res);
+            print_perft(&perft_res);
+            destroy_board(&board);
+            break;
+        case MODE_GENERATE:
+            if (file == NULL) {
+                out = stdout;
+            } else if ((out = fopen(file, "w")) == NULL) {
+                printf("Can't write to %s.\n", file);
+                return 1;
+            }
+            generate_corpus(out, &size, count, min_ply, max_ply, seed);
+            if (out != stdout)
+                fclose(out);
+            break;
+        case MODE_RESUME:
+            if (resume_solve(file) == UNKNOWN)
+                return 1;
+            break;
+        case MODE_BENCH:
+            if (is_record_file(file)) {
+                if (replay_records(file, NULL, &stats) < 0)
+                    return 1;
+            } else if (replay_corpus(file, NULL, &stats) < 0) {
+                return 1;
+            }
+            print_corpus_stats(&stats);
+            return stats.mismatches != 0;
+        case MODE_BUILD_DB:
+            if (file == NULL) {
+                printf("Building a database needs an output file.\n");
+                usage();
+            }
+            if (build_db(&size, file) < 0)
+                return 1;
+            break;
+        case MODE_CONVERT:
+            if (is_record_file(input)) {
+                if (file == NULL) {
+                    out = stdout;
+                } else if ((out = fopen(file, "w")) == NULL) {
+                    printf("Can't write to %s.\n", file);
+                    return 1;
+                }
+                n = records_to_text(input, out);
+            } else {
+                if (file == NULL) {
+                    printf("Converting to records needs an output file.\n");
+                    usage();
+                }
+                if ((in = fopen(input, "r")) == NULL) {
+                    printf("Can't open corpus %s.\n", input);
+                    return 1;
+                }
+                if ((out = fopen(file, "wb")) == NULL) {
+                    printf("Can't write to %s.\n", file);
+                    return 1;
+                }
+                n = text_to_records(in, out);
+                fclose(in);
+            }
+            if (out != stdout)
+                fclose(out);
+            if (n < 0)
+                return 1;
+            if (out != stdout)
+                printf("Converted %ld games.\n", n);
+            break;
+        case MODE_TUNE:
+            if (tune_params(file, params_file()) < 0)
+                return 1;
+            break;
         default:
             abort();
     }
+    if (progress_out != NULL && progress_out != stderr)
+        fclose(progress_out);
+    if (db != NULL) {
+        set_db(NULL);
+        close_db(db);
+    }
+    if (trace_out != NULL) {
+        set_trace(NULL, 0);
+        fclose(trace_out);
+    }
     return 0;
 }
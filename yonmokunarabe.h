@@ -9,7 +9,16 @@
 enum modes { 
     MODE_NONE,
     MODE_SOLVE,
-    MODE_RECOMMEND
+    MODE_RECOMMEND,
+    MODE_ANALYZE,
+    MODE_PERFT,
+    MODE_GENERATE,
+    MODE_BENCH,
+    MODE_RESUME,
+    MODE_TUNE,
+    MODE_BUILD_DB,
+    MODE_CONVERT,
+    MODE_MATRIX
 };
 
 void usage(); 